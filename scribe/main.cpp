@@ -32,12 +32,17 @@ void printHelpText( bool err ) {
     ( err ? std::cerr : std::cout ) << "Wayland::Scribe " << PROJECT_VERSION << std::endl << std::endl;
 
     ( err ? std::cerr : std::cout ) << "Usage:" << std::endl;
-    ( err ? std::cerr : std::cout ) << "  wayland-scribe --[server|client] specfile [options] --[source|header] output" << std::endl << std::endl;
+    ( err ? std::cerr : std::cout ) << "  wayland-scribe --[server|client] specfile [options] --[source|header] output" << std::endl;
+    ( err ? std::cerr : std::cout ) << "  wayland-scribe --emit-decoder specfile output" << std::endl;
+    ( err ? std::cerr : std::cout ) << "  wayland-scribe --emit-direct specfile output" << std::endl << std::endl;
 
     ( err ? std::cerr : std::cout ) << "Options:" << std::endl;
     ( err ? std::cerr : std::cout ) << "  --header-path <path>      Path to the c header of this protocol (optional)." << std::endl;
     ( err ? std::cerr : std::cout ) << "  --prefix <prefix>         Prefix of interfaces (to be stripped; optional)." << std::endl;
-    ( err ? std::cerr : std::cout ) << "  --add-include <include>   Add extra include path (can speficy multiple times; optional)." << std::endl << std::endl;
+    ( err ? std::cerr : std::cout ) << "  --add-include <include>   Add extra include path (can speficy multiple times; optional)." << std::endl;
+    ( err ? std::cerr : std::cout ) << "  --stats                   Publish message counters for wayland-scribe-top (optional)." << std::endl;
+    ( err ? std::cerr : std::cout ) << "  --accounting              Track live resources per client (server only; optional)." << std::endl;
+    ( err ? std::cerr : std::cout ) << "  --direct                  Allow connecting server and client in-process with --emit-direct (optional)." << std::endl << std::endl;
 
     ( err ? std::cerr : std::cout ) << "Other options:" << std::endl;
     ( err ? std::cerr : std::cout ) << "  -h|--help                 Print this help text and exit." << std::endl;
@@ -58,11 +63,16 @@ int main( int argc, char **argv ) {
     ( "v,version", "Print application version and exit" )
     ( "s,server", "Generate the server-side wrapper code for the given protocol.", cxxopts::value<std::string> () )
     ( "c,client", "Generate the client-side wrapper code for the given protocol.", cxxopts::value<std::string> () )
+    ( "emit-decoder", "Generate a standalone decoder of captured wire traffic for the given protocol.", cxxopts::value<std::string> () )
+    ( "emit-direct", "Generate the in-process shim connecting the server and client classes of the given protocol.", cxxopts::value<std::string> () )
     ( "source", "Generate the header code for the given protocol." )
     ( "header", "Generate the source code for the given protocol." )
     ( "header-path", "Path to the c header of this protocol (optional).", cxxopts::value<std::string> () )
     ( "prefix", "Prefix of interfaces (to be stripped; optional).", cxxopts::value<std::string> () )
     ( "add-include", "Additional include paths", cxxopts::value<std::vector<std::string> > () )
+    ( "stats", "Publish message counters into a shared-memory segment (optional)." )
+    ( "accounting", "Track live resources per client in the server classes (optional)." )
+    ( "direct", "Add the hooks used by the in-process shim (optional)." )
     ( "output", "N", cxxopts::value<std::vector<std::string> > () );
 
     options.parse_positional( { "output" } );
@@ -80,9 +90,9 @@ int main( int argc, char **argv ) {
         return 0;
     }
 
-    /** == Server and Client == **/
-    if ( result.count( "server" ) == result.count( "client" ) ) {
-        std::cerr << "[Error]: Please specify one of --server or --client" << std::endl << std::endl;
+    /** == Server, Client, Decoder or Shim == **/
+    if ( result.count( "server" ) + result.count( "client" ) + result.count( "emit-decoder" ) + result.count( "emit-direct" ) != 1 ) {
+        std::cerr << "[Error]: Please specify one of --server, --client, --emit-decoder or --emit-direct" << std::endl << std::endl;
         printHelpText( true );
 
         return EXIT_FAILURE;
@@ -124,6 +134,14 @@ int main( int argc, char **argv ) {
         specFile = result[ "client" ].as<std::string>();
     }
 
+    else if ( result.count( "emit-decoder" ) ) {
+        specFile = result[ "emit-decoder" ].as<std::string>();
+    }
+
+    else if ( result.count( "emit-direct" ) ) {
+        specFile = result[ "emit-direct" ].as<std::string>();
+    }
+
     // /** Ensure that that file exists */
     if ( fs::exists( specFile ) == false ) {
         std::cerr << "[Error]: Unable to locate the file" << specFile.c_str();
@@ -137,11 +155,32 @@ int main( int argc, char **argv ) {
     std::vector<std::string> posArgs = result[ "output" ].as<std::vector<std::string> >();
     std::string              output  = ( posArgs.size() ? posArgs.at( 0 ) : "" );
 
+    /** The decoder and the shim do not depend on the wrapper options */
+    if ( result.count( "emit-decoder" ) || result.count( "emit-direct" ) ) {
+        if ( result.count( "emit-decoder" ) ) {
+            scribe.setDecoderMode( specFile, output );
+        }
+
+        else {
+            scribe.setDirectMode( specFile, output );
+        }
+
+        if ( !scribe.process() ) {
+            std::cerr << "Errors encountered while parsing the xml file" << std::endl << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
     /** Set the main running mode */
     scribe.setRunMode( specFile, result.count( "server" ), file, output );
 
     /** Update other arguments */
     scribe.setArgs( result[ "header-path" ].as<std::string>(), result[ "prefix" ].as<std::string>(), result[ "add-include" ].as<std::vector<std::string> >() );
+    scribe.setStatistics( result.count( "stats" ) );
+    scribe.setAccounting( result.count( "accounting" ) );
+    scribe.setDirect( result.count( "direct" ) );
 
     if ( !scribe.process() ) {
         // scribe.printErrors();
@@ -0,0 +1,1078 @@
+/**
+ * This file contains the code for WaylandScribe.
+ * WaylandScribe reads wayland protocols in xml format and generates
+ * C++ code.
+ *
+ * This part generates a standalone decoder of captured Wayland wire
+ * traffic (wayland-scribe --emit-decoder). The decoder is a single
+ * C++ source file without dependencies on libwayland.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the FSF website:
+ * https://www.gnu.org/licenses/gpl-3.0.html#license-text
+ **/
+
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "wayland-scribe.hpp"
+
+/**
+ * The core objects every session starts with. Captures are decoded with
+ * the protocol being generated, and these are added when it does not
+ * define them (i.e. it is not wayland.xml itself), so that the object ids
+ * can be followed from wl_display through wl_registry::bind.
+ */
+static const char *coreProtocol =
+    "<protocol name=\"wayland\">"
+    "  <interface name=\"wl_display\" version=\"1\">"
+    "    <request name=\"sync\"><arg name=\"callback\" type=\"new_id\" interface=\"wl_callback\"/></request>"
+    "    <request name=\"get_registry\"><arg name=\"registry\" type=\"new_id\" interface=\"wl_registry\"/></request>"
+    "    <event name=\"error\"><arg name=\"object_id\" type=\"object\"/><arg name=\"code\" type=\"uint\"/><arg name=\"message\" type=\"string\"/></event>"
+    "    <event name=\"delete_id\"><arg name=\"id\" type=\"uint\"/></event>"
+    "  </interface>"
+    "  <interface name=\"wl_registry\" version=\"1\">"
+    "    <request name=\"bind\"><arg name=\"name\" type=\"uint\"/><arg name=\"id\" type=\"new_id\"/></request>"
+    "    <event name=\"global\"><arg name=\"name\" type=\"uint\"/><arg name=\"interface\" type=\"string\"/><arg name=\"version\" type=\"uint\"/></event>"
+    "    <event name=\"global_remove\"><arg name=\"name\" type=\"uint\"/></event>"
+    "  </interface>"
+    "  <interface name=\"wl_callback\" version=\"1\">"
+    "    <event name=\"done\" type=\"destructor\"><arg name=\"callback_data\" type=\"uint\"/></event>"
+    "  </interface>"
+    "</protocol>";
+
+
+static const char *decoderArgKind( const std::string& type, const std::string& interface ) {
+    if ( type == "int" ) {
+        return "Arg::Int";
+    }
+
+    else if ( type == "uint" ) {
+        return "Arg::Uint";
+    }
+
+    else if ( type == "fixed" ) {
+        return "Arg::Fixed";
+    }
+
+    else if ( type == "string" ) {
+        return "Arg::String";
+    }
+
+    else if ( type == "object" ) {
+        return "Arg::Object";
+    }
+
+    else if ( type == "new_id" ) {
+        return interface.empty() ? "Arg::UntypedNewId" : "Arg::NewId";
+    }
+
+    else if ( type == "array" ) {
+        return "Arg::Array";
+    }
+
+    return "Arg::Fd";
+}
+
+
+void Wayland::Scribe::generateDecoder( FILE *code, std::vector<WaylandInterface> interfaces ) {
+    pugi::xml_document core;
+
+    core.load_string( coreProtocol );
+
+    /** Core interfaces go first: wl_display is always object 1 */
+    std::vector<WaylandInterface> coreInterfaces;
+
+    for (pugi::xml_node interfaceNode : core.child( "protocol" ).children( "interface" ) ) {
+        WaylandInterface interface = readInterface( interfaceNode );
+        bool             defined   = false;
+
+        for (const WaylandInterface& i : interfaces) {
+            defined = defined || ( i.name == interface.name );
+        }
+
+        if ( !defined ) {
+            coreInterfaces.push_back( interface );
+        }
+    }
+
+    interfaces.insert( interfaces.begin(), coreInterfaces.begin(), coreInterfaces.end() );
+
+    std::map<std::string, size_t> indices;
+
+    for (size_t i = 0; i < interfaces.size(); i++) {
+        indices[ interfaces.at( i ).name ] = i;
+    }
+
+    fprintf( code, "\n" );
+    fprintf( code, "// Standalone decoder of captured Wayland traffic for the %s protocol.\n", mProtocolName.c_str() );
+    fprintf( code, "// Build with: c++ -O2 -std=c++17 <this file> -o <decoder>\n" );
+    fprintf( code, "\n" );
+
+    fprintf( code, "#include <vector>\n" );
+    fprintf( code, "#include <algorithm>\n" );
+    fprintf( code, "#include <cerrno>\n" );
+    fprintf( code, "#include <cstdio>\n" );
+    fprintf( code, "#include <cstdint>\n" );
+    fprintf( code, "#include <cstdlib>\n" );
+    fprintf( code, "#include <cstring>\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "#include <fcntl.h>\n" );
+    fprintf( code, "#include <unistd.h>\n" );
+    fprintf( code, "#include <sys/mman.h>\n" );
+    fprintf( code, "#include <sys/stat.h>\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "namespace Decoder {\n" );
+    fprintf( code, "    enum class Arg : uint8_t {\n" );
+    fprintf( code, "        Int,\n" );
+    fprintf( code, "        Uint,\n" );
+    fprintf( code, "        Fixed,\n" );
+    fprintf( code, "        String,\n" );
+    fprintf( code, "        Object,\n" );
+    fprintf( code, "        NewId,\n" );
+    fprintf( code, "        UntypedNewId,\n" );
+    fprintf( code, "        Array,\n" );
+    fprintf( code, "        Fd,\n" );
+    fprintf( code, "    };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    struct Message {\n" );
+    fprintf( code, "        const char        *name;\n" );
+    fprintf( code, "        const char        *signature;\n" );
+    fprintf( code, "        uint32_t          argCount;\n" );
+    fprintf( code, "        const Arg         *args;\n" );
+    fprintf( code, "        const char *const *argNames;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        /** Interface created by each new_id argument; -1 otherwise */\n" );
+    fprintf( code, "        const int16_t     *types;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        /** Smallest possible size on the wire, header included */\n" );
+    fprintf( code, "        uint32_t          minSize;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        /** Creates objects, or is wl_display::delete_id */\n" );
+    fprintf( code, "        bool              tracksObjects;\n" );
+    fprintf( code, "        bool              deletesId;\n" );
+    fprintf( code, "    };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    struct Interface {\n" );
+    fprintf( code, "        const char    *name;\n" );
+    fprintf( code, "        uint32_t      requestCount;\n" );
+    fprintf( code, "        const Message *requests;\n" );
+    fprintf( code, "        uint32_t      eventCount;\n" );
+    fprintf( code, "        const Message *events;\n" );
+    fprintf( code, "    };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    constexpr uint32_t argWireSize( Arg arg ) {\n" );
+    fprintf( code, "        switch ( arg ) {\n" );
+    fprintf( code, "            case Arg::Fd: {\n" );
+    fprintf( code, "                return 0;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            case Arg::UntypedNewId: {\n" );
+    fprintf( code, "                return 12;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            default: {\n" );
+    fprintf( code, "                return 4;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    template<size_t N>\n" );
+    fprintf( code, "    constexpr uint32_t minSize( const Arg ( &args )[ N ] ) {\n" );
+    fprintf( code, "        uint32_t size = 8;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        for ( size_t i = 0; i < N; i++ ) {\n" );
+    fprintf( code, "            size += argWireSize( args[ i ] );\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        return size;\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    template<size_t N>\n" );
+    fprintf( code, "    constexpr bool createsObjects( const Arg ( &args )[ N ] ) {\n" );
+    fprintf( code, "        for ( size_t i = 0; i < N; i++ ) {\n" );
+    fprintf( code, "            if ( ( args[ i ] == Arg::NewId ) || ( args[ i ] == Arg::UntypedNewId ) ) {\n" );
+    fprintf( code, "                return true;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        return false;\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "}\n" );
+
+    fprintf( code, "\n" );
+    fprintf( code, "namespace Decoder {\n" );
+    fprintf( code, "    constexpr const char *protocolName = \"%s\";\n", mProtocolName.c_str() );
+    fprintf( code, "\n" );
+
+    /** Per-message constexpr layouts: argument kinds, names and the interfaces of new objects */
+    fprintf( code, "    namespace Layout {\n" );
+
+    for (const WaylandInterface& interface : interfaces) {
+        for (const WaylandEvent& e : interface.requests) {
+            printDecoderLayout( code, interface, e, indices );
+        }
+
+        for (const WaylandEvent& e : interface.events) {
+            printDecoderLayout( code, interface, e, indices );
+        }
+    }
+
+    fprintf( code, "    }\n" );
+
+    for (const WaylandInterface& interface : interfaces) {
+        if ( !interface.requests.empty() ) {
+            fprintf( code, "\n" );
+            fprintf( code, "    constexpr Message %s_requests[] = {\n", interface.name.c_str() );
+
+            for (const WaylandEvent& e : interface.requests) {
+                printDecoderMessage( code, interface, e );
+            }
+
+            fprintf( code, "    };\n" );
+        }
+
+        if ( !interface.events.empty() ) {
+            fprintf( code, "\n" );
+            fprintf( code, "    constexpr Message %s_events[] = {\n", interface.name.c_str() );
+
+            for (const WaylandEvent& e : interface.events) {
+                printDecoderMessage( code, interface, e );
+            }
+
+            fprintf( code, "    };\n" );
+        }
+    }
+
+    fprintf( code, "\n" );
+    fprintf( code, "    constexpr Interface interfaces[] = {\n" );
+
+    for (const WaylandInterface& interface : interfaces) {
+        std::string requests = ( interface.requests.empty() ? "nullptr" : interface.name + "_requests" );
+        std::string events   = ( interface.events.empty() ? "nullptr" : interface.name + "_events" );
+
+        fprintf(
+            code, "        { \"%s\", %zu, %s, %zu, %s },\n", interface.name.c_str(),
+            interface.requests.size(), requests.c_str(), interface.events.size(), events.c_str()
+        );
+    }
+
+    fprintf( code, "    };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    constexpr int16_t displayInterface = %zu;\n", indices[ "wl_display" ] );
+    fprintf( code, "}\n" );
+
+    fprintf( code, "\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "namespace Decoder {\n" );
+    fprintf( code, "    constexpr uint32_t InterfaceCount = sizeof( interfaces ) / sizeof( interfaces[ 0 ] );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    /** Ids allocated by the server start here */\n" );
+    fprintf( code, "    constexpr uint32_t ServerIdStart = 0xff000000;\n" );
+    fprintf( code, "    constexpr int16_t  Untracked     = -1;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    enum Direction : uint8_t {\n" );
+    fprintf( code, "        Request = 0,\n" );
+    fprintf( code, "        Event   = 1,\n" );
+    fprintf( code, "    };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    enum class Format {\n" );
+    fprintf( code, "        Summary,\n" );
+    fprintf( code, "        Json,\n" );
+    fprintf( code, "        Binary,\n" );
+    fprintf( code, "    };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    /** Header of each chunk of a framed capture, followed by @length bytes of one direction */\n" );
+    fprintf( code, "    struct FrameHeader {\n" );
+    fprintf( code, "        uint32_t length;\n" );
+    fprintf( code, "        uint8_t  direction;\n" );
+    fprintf( code, "        uint8_t  reserved[ 3 ];\n" );
+    fprintf( code, "    };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    /** Header of each record of the binary output, followed by @length bytes of arguments in wire format */\n" );
+    fprintf( code, "    struct RecordHeader {\n" );
+    fprintf( code, "        uint32_t object;\n" );
+    fprintf( code, "        int16_t  interface;\n" );
+    fprintf( code, "        uint16_t opcode;\n" );
+    fprintf( code, "        uint8_t  direction;\n" );
+    fprintf( code, "        uint8_t  reserved[ 3 ];\n" );
+    fprintf( code, "        uint32_t length;\n" );
+    fprintf( code, "    };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    static_assert( sizeof( FrameHeader ) == 8, \"Unexpected frame header layout\" );\n" );
+    fprintf( code, "    static_assert( sizeof( RecordHeader ) == 16, \"Unexpected record header layout\" );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    int16_t findInterface( const char *name, size_t length ) {\n" );
+    fprintf( code, "        for ( uint32_t i = 0; i < InterfaceCount; i++ ) {\n" );
+    fprintf( code, "            if ( ( strncmp( interfaces[ i ].name, name, length ) == 0 ) && ( interfaces[ i ].name[ length ] == '\\0' ) ) {\n" );
+    fprintf( code, "                return int16_t( i );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        return Untracked;\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    /** Interface of every live object, indexed by id */\n" );
+    fprintf( code, "    class Objects {\n" );
+    fprintf( code, "        public:\n" );
+    fprintf( code, "            Objects() {\n" );
+    fprintf( code, "                set( 1, displayInterface );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            int16_t get( uint32_t id ) const {\n" );
+    fprintf( code, "                const std::vector<int16_t>& table = ( id >= ServerIdStart ? mServer : mClient );\n" );
+    fprintf( code, "                uint32_t                    index = ( id >= ServerIdStart ? id - ServerIdStart : id );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                return index < table.size() ? table[ index ] : Untracked;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void set( uint32_t id, int16_t interface ) {\n" );
+    fprintf( code, "                std::vector<int16_t>& table = ( id >= ServerIdStart ? mServer : mClient );\n" );
+    fprintf( code, "                uint32_t              index = ( id >= ServerIdStart ? id - ServerIdStart : id );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                /** Ids are allocated densely; anything far beyond is garbage */\n" );
+    fprintf( code, "                if ( index >= ( 1u << 24 ) ) {\n" );
+    fprintf( code, "                    return;\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                if ( index >= table.size() ) {\n" );
+    fprintf( code, "                    table.resize( std::max<size_t>( index + 1, table.size() * 2 ), Untracked );\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                table[ index ] = interface;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        private:\n" );
+    fprintf( code, "            std::vector<int16_t> mClient;\n" );
+    fprintf( code, "            std::vector<int16_t> mServer;\n" );
+    fprintf( code, "    };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    class Output {\n" );
+    fprintf( code, "        public:\n" );
+    fprintf( code, "            explicit Output( int fd ) : mFd( fd ) {\n" );
+    fprintf( code, "                mBuffer.reserve( Capacity );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            ~Output() {\n" );
+    fprintf( code, "                flush();\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void append( const void *data, size_t length ) {\n" );
+    fprintf( code, "                if ( mBuffer.size() + length > Capacity ) {\n" );
+    fprintf( code, "                    flush();\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                mBuffer.append( static_cast<const char *>( data ), length );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void append( const char *str ) {\n" );
+    fprintf( code, "                append( str, strlen( str ) );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void append( char ch ) {\n" );
+    fprintf( code, "                if ( mBuffer.size() + 1 > Capacity ) {\n" );
+    fprintf( code, "                    flush();\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                mBuffer.push_back( ch );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void appendNumber( uint64_t value, bool negative = false ) {\n" );
+    fprintf( code, "                char buffer[ 24 ];\n" );
+    fprintf( code, "                char *p = buffer + sizeof( buffer );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                do {\n" );
+    fprintf( code, "                    *--p   = char( '0' + value %% 10 );\n" );
+    fprintf( code, "                    value /= 10;\n" );
+    fprintf( code, "                } while ( value );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                if ( negative ) {\n" );
+    fprintf( code, "                    *--p = '-';\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                append( p, buffer + sizeof( buffer ) - p );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void appendInt( int32_t value ) {\n" );
+    fprintf( code, "                appendNumber( value < 0 ? uint64_t( -int64_t( value ) ) : uint64_t( value ), value < 0 );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void appendJsonString( const char *str, size_t length ) {\n" );
+    fprintf( code, "                static const char *hex = \"0123456789abcdef\";\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                append( '\"' );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                for ( size_t i = 0; i < length; i++ ) {\n" );
+    fprintf( code, "                    unsigned char ch = str[ i ];\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( ( ch == '\"' ) || ( ch == '\\\\' ) ) {\n" );
+    fprintf( code, "                        append( '\\\\' );\n" );
+    fprintf( code, "                        append( char( ch ) );\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    else if ( ch < 0x20 ) {\n" );
+    fprintf( code, "                        char escape[ 6 ] = { '\\\\', 'u', '0', '0', hex[ ch >> 4 ], hex[ ch & 0xf ] };\n" );
+    fprintf( code, "                        append( escape, sizeof( escape ) );\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    else {\n" );
+    fprintf( code, "                        append( char( ch ) );\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                append( '\"' );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void flush() {\n" );
+    fprintf( code, "                size_t done = 0;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                while ( done < mBuffer.size() ) {\n" );
+    fprintf( code, "                    ssize_t ret = write( mFd, mBuffer.data() + done, mBuffer.size() - done );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( ret < 0 ) {\n" );
+    fprintf( code, "                        if ( errno == EINTR ) {\n" );
+    fprintf( code, "                            continue;\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        perror( \"write\" );\n" );
+    fprintf( code, "                        exit( EXIT_FAILURE );\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    done += size_t( ret );\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                mBuffer.clear();\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        private:\n" );
+    fprintf( code, "            static constexpr size_t Capacity = 1 << 20;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            int         mFd;\n" );
+    fprintf( code, "            std::string mBuffer;\n" );
+    fprintf( code, "    };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    class Stream {\n" );
+    fprintf( code, "        public:\n" );
+    fprintf( code, "            Stream( Format format, Output& output ) : mFormat( format ), mOutput( output ) {\n" );
+    fprintf( code, "                for ( uint32_t i = 0; i < InterfaceCount; i++ ) {\n" );
+    fprintf( code, "                    mCountOffsets[ i ] = mCounts.size();\n" );
+    fprintf( code, "                    mCounts.resize( mCounts.size() + interfaces[ i ].requestCount + interfaces[ i ].eventCount, 0 );\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                if ( mFormat == Format::Binary ) {\n" );
+    fprintf( code, "                    writeSchema();\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            Objects& objects() {\n" );
+    fprintf( code, "                return mObjects;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            /** Decode the next @length bytes of the @direction stream; partial messages are kept for later */\n" );
+    fprintf( code, "            bool feed( Direction direction, const uint8_t *data, size_t length ) {\n" );
+    fprintf( code, "                std::vector<uint8_t>& carry = mCarry[ direction ];\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                if ( mBroken[ direction ] ) {\n" );
+    fprintf( code, "                    return false;\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                while ( carry.size() && length ) {\n" );
+    fprintf( code, "                    size_t needed = ( carry.size() < 8 ? 8 : messageSize( carry.data() ) ) - carry.size();\n" );
+    fprintf( code, "                    size_t taken  = std::min( needed, length );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    carry.insert( carry.end(), data, data + taken );\n" );
+    fprintf( code, "                    data   += taken;\n" );
+    fprintf( code, "                    length -= taken;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( carry.size() < 8 ) {\n" );
+    fprintf( code, "                        continue;\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( messageSize( carry.data() ) < 8 ) {\n" );
+    fprintf( code, "                        return desync( direction );\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( carry.size() == messageSize( carry.data() ) ) {\n" );
+    fprintf( code, "                        decodeMessage( direction, carry.data() );\n" );
+    fprintf( code, "                        carry.clear();\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                while ( length >= 8 ) {\n" );
+    fprintf( code, "                    uint32_t size = messageSize( data );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( size < 8 ) {\n" );
+    fprintf( code, "                        return desync( direction );\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( size > length ) {\n" );
+    fprintf( code, "                        break;\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    decodeMessage( direction, data );\n" );
+    fprintf( code, "                    data   += size;\n" );
+    fprintf( code, "                    length -= size;\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                carry.insert( carry.end(), data, data + length );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                return true;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void printSummary( FILE *f ) {\n" );
+    fprintf( code, "                for ( uint32_t i = 0; i < InterfaceCount; i++ ) {\n" );
+    fprintf( code, "                    const Interface& iface = interfaces[ i ];\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    for ( uint32_t op = 0; op < iface.requestCount + iface.eventCount; op++ ) {\n" );
+    fprintf( code, "                        uint64_t count = mCounts[ mCountOffsets[ i ] + op ];\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        if ( count ) {\n" );
+    fprintf( code, "                            bool request = op < iface.requestCount;\n" );
+    fprintf( code, "                            fprintf(\n" );
+    fprintf( code, "                                f, \"%%-9s %%s.%%s: %%lu\\n\", request ? \"request\" : \"event\", iface.name,\n" );
+    fprintf( code, "                                request ? iface.requests[ op ].name : iface.events[ op - iface.requestCount ].name, (unsigned long)count\n" );
+    fprintf( code, "                            );\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                fprintf( f, \"%%lu messages, %%lu bytes; %%lu messages on unknown objects\\n\", (unsigned long)mMessages, (unsigned long)mBytes, (unsigned long)mUnknown );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        private:\n" );
+    fprintf( code, "            static uint32_t read32( const uint8_t *p ) {\n" );
+    fprintf( code, "                uint32_t value;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                memcpy( &value, p, sizeof( value ) );\n" );
+    fprintf( code, "                return value;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            static uint32_t messageSize( const uint8_t *p ) {\n" );
+    fprintf( code, "                return read32( p + 4 ) >> 16;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            bool desync( Direction direction ) {\n" );
+    fprintf( code, "                fprintf( stderr, \"[Error]: Invalid message size in the %%s stream; giving up on it\\n\", direction == Request ? \"request\" : \"event\" );\n" );
+    fprintf( code, "                mCarry[ direction ].clear();\n" );
+    fprintf( code, "                mBroken[ direction ] = true;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                return false;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void writeSchema() {\n" );
+    fprintf( code, "                auto writeString = [ this ] ( const char *str ) {\n" );
+    fprintf( code, "                                       uint16_t length = uint16_t( strlen( str ) );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                                       mOutput.append( &length, sizeof( length ) );\n" );
+    fprintf( code, "                                       mOutput.append( str, length );\n" );
+    fprintf( code, "                                   };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                auto writeMessages = [ & ] ( const Message *messages, uint32_t count ) {\n" );
+    fprintf( code, "                                         for ( uint32_t m = 0; m < count; m++ ) {\n" );
+    fprintf( code, "                                             writeString( messages[ m ].name );\n" );
+    fprintf( code, "                                             writeString( messages[ m ].signature );\n" );
+    fprintf( code, "                                         }\n" );
+    fprintf( code, "                                     };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                mOutput.append( \"WSDEC001\", 8 );\n" );
+    fprintf( code, "                mOutput.append( &InterfaceCount, sizeof( InterfaceCount ) );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                for ( uint32_t i = 0; i < InterfaceCount; i++ ) {\n" );
+    fprintf( code, "                    uint16_t counts[ 2 ] = { uint16_t( interfaces[ i ].requestCount ), uint16_t( interfaces[ i ].eventCount ) };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    writeString( interfaces[ i ].name );\n" );
+    fprintf( code, "                    mOutput.append( counts, sizeof( counts ) );\n" );
+    fprintf( code, "                    writeMessages( interfaces[ i ].requests, interfaces[ i ].requestCount );\n" );
+    fprintf( code, "                    writeMessages( interfaces[ i ].events, interfaces[ i ].eventCount );\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void decodeMessage( Direction direction, const uint8_t *data ) {\n" );
+    fprintf( code, "                uint32_t id     = read32( data );\n" );
+    fprintf( code, "                uint32_t size   = messageSize( data );\n" );
+    fprintf( code, "                uint16_t opcode = read32( data + 4 ) & 0xffff;\n" );
+    fprintf( code, "                int16_t  iface  = mObjects.get( id );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                const Message *msg = nullptr;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                if ( iface != Untracked ) {\n" );
+    fprintf( code, "                    const Interface& i = interfaces[ iface ];\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( direction == Request ? opcode < i.requestCount : opcode < i.eventCount ) {\n" );
+    fprintf( code, "                        msg = ( direction == Request ? &i.requests[ opcode ] : &i.events[ opcode ] );\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                mMessages++;\n" );
+    fprintf( code, "                mBytes += size;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                if ( !msg || ( size < msg->minSize ) ) {\n" );
+    fprintf( code, "                    mUnknown++;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( mFormat == Format::Json ) {\n" );
+    fprintf( code, "                        mOutput.append( direction == Request ? \"{\\\"direction\\\":\\\"request\\\",\\\"object\\\":\" : \"{\\\"direction\\\":\\\"event\\\",\\\"object\\\":\" );\n" );
+    fprintf( code, "                        mOutput.appendNumber( id );\n" );
+    fprintf( code, "                        mOutput.append( \",\\\"interface\\\":\" );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        if ( iface != Untracked ) {\n" );
+    fprintf( code, "                            mOutput.append( '\"' );\n" );
+    fprintf( code, "                            mOutput.append( interfaces[ iface ].name );\n" );
+    fprintf( code, "                            mOutput.append( '\"' );\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        else {\n" );
+    fprintf( code, "                            mOutput.append( \"null\" );\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        mOutput.append( \",\\\"opcode\\\":\" );\n" );
+    fprintf( code, "                        mOutput.appendNumber( opcode );\n" );
+    fprintf( code, "                        mOutput.append( \",\\\"size\\\":\" );\n" );
+    fprintf( code, "                        mOutput.appendNumber( size );\n" );
+    fprintf( code, "                        mOutput.append( \"}\\n\" );\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    else if ( mFormat == Format::Binary ) {\n" );
+    fprintf( code, "                        writeRecord( direction, id, Untracked, opcode, data, size );\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    return;\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                mCounts[ mCountOffsets[ iface ] + ( direction == Request ? 0 : interfaces[ iface ].requestCount ) + opcode ]++;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                if ( mFormat == Format::Json ) {\n" );
+    fprintf( code, "                    mOutput.append( direction == Request ? \"{\\\"direction\\\":\\\"request\\\",\\\"object\\\":\" : \"{\\\"direction\\\":\\\"event\\\",\\\"object\\\":\" );\n" );
+    fprintf( code, "                    mOutput.appendNumber( id );\n" );
+    fprintf( code, "                    mOutput.append( \",\\\"interface\\\":\\\"\" );\n" );
+    fprintf( code, "                    mOutput.append( interfaces[ iface ].name );\n" );
+    fprintf( code, "                    mOutput.append( \"\\\",\\\"message\\\":\\\"\" );\n" );
+    fprintf( code, "                    mOutput.append( msg->name );\n" );
+    fprintf( code, "                    mOutput.append( \"\\\",\\\"args\\\":{\" );\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                else if ( mFormat == Format::Binary ) {\n" );
+    fprintf( code, "                    writeRecord( direction, id, iface, opcode, data, size );\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                /** Only messages that create or delete objects need their arguments when not printing them */\n" );
+    fprintf( code, "                if ( ( mFormat == Format::Json ) || msg->tracksObjects ) {\n" );
+    fprintf( code, "                    if ( !decodeArguments( msg, data + 8, data + size ) && ( mFormat == Format::Json ) ) {\n" );
+    fprintf( code, "                        mOutput.append( \"},\\\"truncated\\\":true}\\n\" );\n" );
+    fprintf( code, "                        return;\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                if ( mFormat == Format::Json ) {\n" );
+    fprintf( code, "                    mOutput.append( \"}}\\n\" );\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            bool decodeArguments( const Message *msg, const uint8_t *p, const uint8_t *end ) {\n" );
+    fprintf( code, "                bool json = ( mFormat == Format::Json );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                for ( uint32_t k = 0; k < msg->argCount; k++ ) {\n" );
+    fprintf( code, "                    Arg arg = msg->args[ k ];\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( json ) {\n" );
+    fprintf( code, "                        if ( k ) {\n" );
+    fprintf( code, "                            mOutput.append( ',' );\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        mOutput.append( '\"' );\n" );
+    fprintf( code, "                        mOutput.append( msg->argNames[ k ] );\n" );
+    fprintf( code, "                        mOutput.append( \"\\\":\", 2 );\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( arg == Arg::Fd ) {\n" );
+    fprintf( code, "                        if ( json ) {\n" );
+    fprintf( code, "                            mOutput.append( \"\\\"fd\\\"\" );\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        continue;\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    if ( p + 4 > end ) {\n" );
+    fprintf( code, "                        return false;\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    uint32_t value = read32( p );\n" );
+    fprintf( code, "                    p += 4;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                    switch ( arg ) {\n" );
+    fprintf( code, "                        case Arg::Int: {\n" );
+    fprintf( code, "                            if ( json ) {\n" );
+    fprintf( code, "                                mOutput.appendInt( int32_t( value ) );\n" );
+    fprintf( code, "                            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            break;\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        case Arg::Fixed: {\n" );
+    fprintf( code, "                            if ( json ) {\n" );
+    fprintf( code, "                                char buffer[ 32 ];\n" );
+    fprintf( code, "                                int  length = snprintf( buffer, sizeof( buffer ), \"%%.8g\", int32_t( value ) / 256.0 );\n" );
+    fprintf( code, "                                mOutput.append( buffer, length );\n" );
+    fprintf( code, "                            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            break;\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        case Arg::Uint:\n" );
+    fprintf( code, "                        case Arg::Object: {\n" );
+    fprintf( code, "                            if ( json ) {\n" );
+    fprintf( code, "                                mOutput.appendNumber( value );\n" );
+    fprintf( code, "                            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            if ( msg->deletesId ) {\n" );
+    fprintf( code, "                                mObjects.set( value, Untracked );\n" );
+    fprintf( code, "                            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            break;\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        case Arg::NewId: {\n" );
+    fprintf( code, "                            if ( json ) {\n" );
+    fprintf( code, "                                mOutput.appendNumber( value );\n" );
+    fprintf( code, "                            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            mObjects.set( value, msg->types[ k ] );\n" );
+    fprintf( code, "                            break;\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        case Arg::String:\n" );
+    fprintf( code, "                        case Arg::Array:\n" );
+    fprintf( code, "                        case Arg::UntypedNewId: {\n" );
+    fprintf( code, "                            size_t padded = ( size_t( value ) + 3 ) & ~size_t( 3 );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            if ( size_t( end - p ) < padded ) {\n" );
+    fprintf( code, "                                return false;\n" );
+    fprintf( code, "                            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            const char *str = reinterpret_cast<const char *>( p );\n" );
+    fprintf( code, "                            p += padded;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            if ( arg == Arg::String ) {\n" );
+    fprintf( code, "                                if ( json ) {\n" );
+    fprintf( code, "                                    if ( value ) {\n" );
+    fprintf( code, "                                        mOutput.appendJsonString( str, value - 1 );\n" );
+    fprintf( code, "                                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                                    else {\n" );
+    fprintf( code, "                                        mOutput.append( \"null\" );\n" );
+    fprintf( code, "                                    }\n" );
+    fprintf( code, "                                }\n" );
+    fprintf( code, "                            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            else if ( arg == Arg::Array ) {\n" );
+    fprintf( code, "                                if ( json ) {\n" );
+    fprintf( code, "                                    static const char *hex = \"0123456789abcdef\";\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                                    mOutput.append( '\"' );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                                    for ( uint32_t i = 0; i < value; i++ ) {\n" );
+    fprintf( code, "                                        mOutput.append( hex[ uint8_t( str[ i ] ) >> 4 ] );\n" );
+    fprintf( code, "                                        mOutput.append( hex[ uint8_t( str[ i ] ) & 0xf ] );\n" );
+    fprintf( code, "                                    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                                    mOutput.append( '\"' );\n" );
+    fprintf( code, "                                }\n" );
+    fprintf( code, "                            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            /** interface name, version and id */\n" );
+    fprintf( code, "                            else {\n" );
+    fprintf( code, "                                if ( p + 8 > end ) {\n" );
+    fprintf( code, "                                    return false;\n" );
+    fprintf( code, "                                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                                uint32_t version = read32( p );\n" );
+    fprintf( code, "                                uint32_t id      = read32( p + 4 );\n" );
+    fprintf( code, "                                p += 8;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                                mObjects.set( id, value ? findInterface( str, value - 1 ) : Untracked );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                                if ( json ) {\n" );
+    fprintf( code, "                                    mOutput.append( \"{\\\"interface\\\":\" );\n" );
+    fprintf( code, "                                    mOutput.appendJsonString( str, value ? value - 1 : 0 );\n" );
+    fprintf( code, "                                    mOutput.append( \",\\\"version\\\":\" );\n" );
+    fprintf( code, "                                    mOutput.appendNumber( version );\n" );
+    fprintf( code, "                                    mOutput.append( \",\\\"id\\\":\" );\n" );
+    fprintf( code, "                                    mOutput.appendNumber( id );\n" );
+    fprintf( code, "                                    mOutput.append( '}' );\n" );
+    fprintf( code, "                                }\n" );
+    fprintf( code, "                            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                            break;\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                        case Arg::Fd: {\n" );
+    fprintf( code, "                            break;\n" );
+    fprintf( code, "                        }\n" );
+    fprintf( code, "                    }\n" );
+    fprintf( code, "                }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                return true;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            void writeRecord( Direction direction, uint32_t id, int16_t iface, uint16_t opcode, const uint8_t *data, uint32_t size ) {\n" );
+    fprintf( code, "                RecordHeader header = { id, iface, opcode, direction, { 0, 0, 0 }, size - 8 };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "                mOutput.append( &header, sizeof( header ) );\n" );
+    fprintf( code, "                mOutput.append( data + 8, size - 8 );\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            Format               mFormat;\n" );
+    fprintf( code, "            Output&              mOutput;\n" );
+    fprintf( code, "            Objects              mObjects;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            std::vector<uint8_t> mCarry[ 2 ];\n" );
+    fprintf( code, "            bool                 mBroken[ 2 ] = { false, false };\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            std::vector<uint64_t> mCounts;\n" );
+    fprintf( code, "            size_t                mCountOffsets[ InterfaceCount ];\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            uint64_t mMessages = 0;\n" );
+    fprintf( code, "            uint64_t mBytes    = 0;\n" );
+    fprintf( code, "            uint64_t mUnknown  = 0;\n" );
+    fprintf( code, "    };\n" );
+    fprintf( code, "}\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "static void printHelpText( FILE *f, const char *app ) {\n" );
+    fprintf( code, "    fprintf( f, \"Decoder of captured Wayland traffic for the protocol %%s\\n\\n\", Decoder::protocolName );\n" );
+    fprintf( code, "    fprintf( f, \"Usage:\\n\" );\n" );
+    fprintf( code, "    fprintf( f, \"  %%s [options] capture\\n\\n\", app );\n" );
+    fprintf( code, "    fprintf( f, \"The capture is a sequence of frames: a 32-bit length, an 8-bit direction (0: request,\\n\" );\n" );
+    fprintf( code, "    fprintf( f, \"1: event) and 3 reserved bytes, followed by length bytes of the raw socket stream.\\n\\n\" );\n" );
+    fprintf( code, "    fprintf( f, \"Options:\\n\" );\n" );
+    fprintf( code, "    fprintf( f, \"  --json                    Write one JSON object per message.\\n\" );\n" );
+    fprintf( code, "    fprintf( f, \"  --binary                  Write a schema, and one typed record per message.\\n\" );\n" );
+    fprintf( code, "    fprintf( f, \"  --raw <request|event>     The capture is the raw stream of one direction, without frames.\\n\" );\n" );
+    fprintf( code, "    fprintf( f, \"  --object <id>=<interface> Track the object id as an instance of interface.\\n\" );\n" );
+    fprintf( code, "    fprintf( f, \"  -o <file>                 Write the output to file instead of stdout.\\n\" );\n" );
+    fprintf( code, "    fprintf( f, \"  -h|--help                 Print this help text and exit.\\n\" );\n" );
+    fprintf( code, "}\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "int main( int argc, char **argv ) {\n" );
+    fprintf( code, "    Decoder::Format format = Decoder::Format::Summary;\n" );
+    fprintf( code, "    int             raw    = -1;\n" );
+    fprintf( code, "    const char      *input = nullptr;\n" );
+    fprintf( code, "    const char      *out   = nullptr;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    std::vector<std::pair<uint32_t, int16_t> > seeds;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    for ( int i = 1; i < argc; i++ ) {\n" );
+    fprintf( code, "        std::string arg = argv[ i ];\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        if ( ( arg == \"-h\" ) || ( arg == \"--help\" ) ) {\n" );
+    fprintf( code, "            printHelpText( stdout, argv[ 0 ] );\n" );
+    fprintf( code, "            return EXIT_SUCCESS;\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        else if ( arg == \"--json\" ) {\n" );
+    fprintf( code, "            format = Decoder::Format::Json;\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        else if ( arg == \"--binary\" ) {\n" );
+    fprintf( code, "            format = Decoder::Format::Binary;\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        else if ( ( arg == \"--raw\" ) && ( i + 1 < argc ) ) {\n" );
+    fprintf( code, "            std::string direction = argv[ ++i ];\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            if ( ( direction != \"request\" ) && ( direction != \"event\" ) ) {\n" );
+    fprintf( code, "                fprintf( stderr, \"[Error]: --raw expects 'request' or 'event'\\n\" );\n" );
+    fprintf( code, "                return EXIT_FAILURE;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            raw = ( direction == \"request\" ? Decoder::Request : Decoder::Event );\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        else if ( ( arg == \"--object\" ) && ( i + 1 < argc ) ) {\n" );
+    fprintf( code, "            std::string seed = argv[ ++i ];\n" );
+    fprintf( code, "            size_t      eq   = seed.find( '=' );\n" );
+    fprintf( code, "            int16_t     type = ( eq == std::string::npos ? Decoder::Untracked : Decoder::findInterface( seed.c_str() + eq + 1, seed.size() - eq - 1 ) );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            if ( type == Decoder::Untracked ) {\n" );
+    fprintf( code, "                fprintf( stderr, \"[Error]: Invalid object specification: %%s\\n\", seed.c_str() );\n" );
+    fprintf( code, "                return EXIT_FAILURE;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            seeds.push_back( { uint32_t( strtoul( seed.c_str(), nullptr, 0 ) ), type } );\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        else if ( ( arg == \"-o\" ) && ( i + 1 < argc ) ) {\n" );
+    fprintf( code, "            out = argv[ ++i ];\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        else if ( !input && ( arg[ 0 ] != '-' ) ) {\n" );
+    fprintf( code, "            input = argv[ i ];\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        else {\n" );
+    fprintf( code, "            printHelpText( stderr, argv[ 0 ] );\n" );
+    fprintf( code, "            return EXIT_FAILURE;\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    if ( !input ) {\n" );
+    fprintf( code, "        printHelpText( stderr, argv[ 0 ] );\n" );
+    fprintf( code, "        return EXIT_FAILURE;\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    int fd = open( input, O_RDONLY );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    struct stat st;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    if ( ( fd < 0 ) || ( fstat( fd, &st ) != 0 ) ) {\n" );
+    fprintf( code, "        fprintf( stderr, \"[Error]: Unable to open %%s: %%s\\n\", input, strerror( errno ) );\n" );
+    fprintf( code, "        return EXIT_FAILURE;\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    const uint8_t *data = nullptr;\n" );
+    fprintf( code, "    size_t        size  = size_t( st.st_size );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    if ( size ) {\n" );
+    fprintf( code, "        void *mem = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        if ( mem == MAP_FAILED ) {\n" );
+    fprintf( code, "            fprintf( stderr, \"[Error]: Unable to map %%s: %%s\\n\", input, strerror( errno ) );\n" );
+    fprintf( code, "            return EXIT_FAILURE;\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        madvise( mem, size, MADV_SEQUENTIAL );\n" );
+    fprintf( code, "        data = static_cast<const uint8_t *>( mem );\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    close( fd );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    int outFd = ( out ? open( out, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) : STDOUT_FILENO );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    if ( outFd < 0 ) {\n" );
+    fprintf( code, "        fprintf( stderr, \"[Error]: Unable to open %%s: %%s\\n\", out, strerror( errno ) );\n" );
+    fprintf( code, "        return EXIT_FAILURE;\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    Decoder::Output output( outFd );\n" );
+    fprintf( code, "    Decoder::Stream stream( format, output );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    for ( auto& seed : seeds ) {\n" );
+    fprintf( code, "        stream.objects().set( seed.first, seed.second );\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    if ( raw >= 0 ) {\n" );
+    fprintf( code, "        stream.feed( Decoder::Direction( raw ), data, size );\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    else {\n" );
+    fprintf( code, "        size_t offset = 0;\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "        while ( offset + sizeof( Decoder::FrameHeader ) <= size ) {\n" );
+    fprintf( code, "            Decoder::FrameHeader frame;\n" );
+    fprintf( code, "            memcpy( &frame, data + offset, sizeof( frame ) );\n" );
+    fprintf( code, "            offset += sizeof( frame );\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            if ( ( frame.direction > Decoder::Event ) || ( frame.length > size - offset ) ) {\n" );
+    fprintf( code, "                fprintf( stderr, \"[Error]: Invalid frame at offset %%zu\\n\", offset - sizeof( frame ) );\n" );
+    fprintf( code, "                break;\n" );
+    fprintf( code, "            }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "            stream.feed( Decoder::Direction( frame.direction ), data + offset, frame.length );\n" );
+    fprintf( code, "            offset += frame.length;\n" );
+    fprintf( code, "        }\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    if ( format == Decoder::Format::Summary ) {\n" );
+    fprintf( code, "        output.flush();\n" );
+    fprintf( code, "        stream.printSummary( out ? fdopen( outFd, \"w\" ) : stdout );\n" );
+    fprintf( code, "    }\n" );
+    fprintf( code, "\n" );
+    fprintf( code, "    return EXIT_SUCCESS;\n" );
+    fprintf( code, "}\n" );
+}
+
+
+std::string Wayland::Scribe::decoderLayoutName( const WaylandInterface& interface, const WaylandEvent& e ) {
+    return interface.name + ( e.request ? "_request_" : "_event_" ) + e.name;
+}
+
+
+void Wayland::Scribe::printDecoderLayout( FILE *code, const WaylandInterface& interface, const WaylandEvent& e, std::map<std::string, size_t>& indices ) {
+    if ( e.arguments.empty() ) {
+        return;
+    }
+
+    std::string name = decoderLayoutName( interface, e );
+    std::string kinds;
+    std::string names;
+    std::string types;
+    bool        hasNewId = false;
+
+    for (const WaylandArgument& a : e.arguments) {
+        std::string sep = ( kinds.empty() ? " " : ", " );
+
+        kinds += sep + decoderArgKind( a.type, a.interface );
+        names += sep + "\"" + a.name + "\"";
+
+        /** Interfaces of other protocols are not known to the decoder */
+        if ( ( a.type == "new_id" ) && !a.interface.empty() && indices.count( a.interface ) ) {
+            types += sep + std::to_string( indices[ a.interface ] );
+        }
+
+        else {
+            types += sep + "-1";
+        }
+
+        hasNewId = hasNewId || ( ( a.type == "new_id" ) && !a.interface.empty() );
+    }
+
+    fprintf( code, "        constexpr Arg %s_args[] = {%s };\n",          name.c_str(), kinds.c_str() );
+    fprintf( code, "        constexpr const char *%s_names[] = {%s };\n", name.c_str(), names.c_str() );
+
+    if ( hasNewId ) {
+        fprintf( code, "        constexpr int16_t %s_types[] = {%s };\n", name.c_str(), types.c_str() );
+    }
+}
+
+
+void Wayland::Scribe::printDecoderMessage( FILE *code, const WaylandInterface& interface, const WaylandEvent& e ) {
+    bool deletesId = ( interface.name == "wl_display" ) && !e.request && ( e.name == "delete_id" );
+
+    if ( e.arguments.empty() ) {
+        fprintf( code, "        { \"%s\", \"\", 0, nullptr, nullptr, nullptr, 8, false, false },\n", e.name.c_str() );
+        return;
+    }
+
+    std::string name    = "Layout::" + decoderLayoutName( interface, e );
+    bool        hasType = false;
+
+    for (const WaylandArgument& a : e.arguments) {
+        hasType = hasType || ( ( a.type == "new_id" ) && !a.interface.empty() );
+    }
+
+    fprintf( code, "        {\n" );
+    fprintf( code, "            \"%s\", \"%s\", %zu, %s_args, %s_names, ", e.name.c_str(), e.signature.c_str(), e.arguments.size(), name.c_str(), name.c_str() );
+    fprintf( code, "%s,\n",                                               hasType ? ( name + "_types" ).c_str() : "nullptr" );
+    fprintf( code, "            minSize( %s_args ), ", name.c_str() );
+
+    if ( deletesId ) {
+        fprintf( code, "true, true\n" );
+    }
+
+    else {
+        fprintf( code, "createsObjects( %s_args ), false\n", name.c_str() );
+    }
+
+    fprintf( code, "        },\n" );
+}
@@ -0,0 +1,407 @@
+/**
+ * This file contains the code for WaylandScribe.
+ * WaylandScribe reads wayland protocols in xml format and generates
+ * C++ code.
+ *
+ * This part generates the header-only shim that connects the server
+ * and client classes of a protocol in-process (wayland-scribe
+ * --emit-direct). Both classes have to be generated with --direct.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the FSF website:
+ * https://www.gnu.org/licenses/gpl-3.0.html#license-text
+ **/
+
+
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "wayland-scribe.hpp"
+
+std::string snakeCaseToCamelCase( const std::string& snakeCaseName, bool capitalize );
+
+
+/** Client-side type of an object or new_id argument, as seen by the generated client handlers */
+static std::string clientObjectType( const std::string& interface ) {
+    return interface.empty() ? "struct ::wl_object *" : "struct ::" + interface + " *";
+}
+
+
+void Wayland::Scribe::generateDirectShim( FILE *head, std::vector<WaylandInterface> interfaces ) {
+    std::string fileName = mProtocolName;
+
+    std::replace( fileName.begin(), fileName.end(), '_', '-' );
+
+    /** The server classes skip wl_registry as well */
+    std::vector<WaylandInterface> shimmed;
+    std::set<std::string>         direct;
+
+    for (const WaylandInterface& interface : interfaces) {
+        if ( !ignoreInterface( interface.name ) && ( interface.name != "wl_registry" ) ) {
+            shimmed.push_back( interface );
+            direct.insert( interface.name );
+        }
+    }
+
+    fprintf( head, "#include <wayland-scribe-direct.hpp>\n" );
+    fprintf( head, "\n" );
+    fprintf( head, "#include \"%s-server.hpp\"\n", fileName.c_str() );
+    fprintf( head, "#include \"%s-client.hpp\"\n", fileName.c_str() );
+    fprintf( head, "\n" );
+    fprintf( head, "namespace Wayland {\n" );
+    fprintf( head, "namespace Direct {\n" );
+
+    for (size_t i = 0; i < shimmed.size(); i++) {
+        if ( i ) {
+            fprintf( head, "\n" );
+        }
+
+        printDirectClass( head, shimmed.at( i ) );
+    }
+
+    fprintf( head, "}\n" );
+    fprintf( head, "}\n" );
+
+    /** Defined after all the classes: requests and events create objects of the other interfaces */
+    for (const WaylandInterface& interface : shimmed) {
+        std::string interfaceNameBA = snakeCaseToCamelCase( interface.name, true );
+        const char  *interfaceName  = interfaceNameBA.data();
+        const char  *objectName     = interface.name.c_str();
+
+        fprintf( head, "\n" );
+        fprintf( head, "inline Wayland::Direct::%s::%s(Connection *connection)\n", interfaceName, interfaceName );
+        fprintf( head, "    : Object(connection) {\n" );
+        fprintf( head, "    Wayland::Client::%s::registerDirect(object(), this);\n", interfaceName );
+        fprintf( head, "}\n" );
+        fprintf( head, "\n" );
+
+        fprintf( head, "inline Wayland::Direct::%s::~%s() {\n", interfaceName, interfaceName );
+        fprintf( head, "    Wayland::Client::%s::unregisterDirect(object());\n", interfaceName );
+        fprintf( head, "\n" );
+        fprintf( head, "    if (m_clientObject) {\n" );
+        fprintf( head, "        m_clientObject->m_direct = nullptr;\n" );
+        fprintf( head, "        m_clientObject->m_%s = nullptr;\n", objectName );
+        fprintf( head, "    }\n" );
+        fprintf( head, "\n" );
+        fprintf( head, "    // A resource outliving this object posts its events to the socket again, where flush() discards them\n" );
+        fprintf( head, "    Wayland::Server::%s::Resource *r = Wayland::Server::%s::Resource::fromResource(resource());\n", interfaceName, interfaceName );
+        fprintf( head, "    if (r)\n" );
+        fprintf( head, "        r->directPeer = nullptr;\n" );
+        fprintf( head, "}\n" );
+        fprintf( head, "\n" );
+
+        fprintf( head, "inline struct ::%s *Wayland::Direct::%s::bind(Connection *connection, Wayland::Server::%s *global, int version) {\n", objectName, interfaceName, interfaceName );
+        fprintf( head, "    Wayland::Direct::%s *direct = new Wayland::Direct::%s(connection);\n", interfaceName, interfaceName );
+        fprintf( head, "    uint32_t id = connection->newId();\n" );
+        fprintf( head, "\n" );
+        fprintf( head, "    Wayland::Server::%s::expectDirect(connection->client(), id, direct);\n", interfaceName );
+        fprintf( head, "    global->add(connection->client(), id, version);\n" );
+        fprintf( head, "    return direct->object();\n" );
+        fprintf( head, "}\n" );
+        fprintf( head, "\n" );
+
+        fprintf( head, "inline struct ::%s *Wayland::Direct::%s::adopt(Connection *connection, struct ::wl_resource *handle) {\n", objectName, interfaceName );
+        fprintf( head, "    Wayland::Server::%s::Resource *r = Wayland::Server::%s::Resource::fromResource(handle);\n", interfaceName, interfaceName );
+        fprintf( head, "    if (!r)\n" );
+        fprintf( head, "        return nullptr;\n" );
+        fprintf( head, "\n" );
+        fprintf( head, "    Wayland::Direct::%s *direct = new Wayland::Direct::%s(connection);\n", interfaceName, interfaceName );
+        fprintf( head, "    r->directPeer = direct;\n" );
+        fprintf( head, "    direct->setResource(handle);\n" );
+        fprintf( head, "    return direct->object();\n" );
+        fprintf( head, "}\n" );
+        fprintf( head, "\n" );
+
+        fprintf( head, "inline void Wayland::Direct::%s::directAttach(Wayland::Client::%s *clientObject) {\n", interfaceName, interfaceName );
+        fprintf( head, "    m_clientObject = clientObject;\n" );
+        fprintf( head, "}\n" );
+        fprintf( head, "\n" );
+
+        fprintf( head, "inline Wayland::Client::%s *Wayland::Direct::%s::directObject() const {\n", interfaceName, interfaceName );
+        fprintf( head, "    return m_clientObject;\n" );
+        fprintf( head, "}\n" );
+        fprintf( head, "\n" );
+
+        fprintf( head, "inline void Wayland::Direct::%s::directBind(struct ::wl_resource *handle) {\n", interfaceName );
+        fprintf( head, "    setResource(handle);\n" );
+        fprintf( head, "}\n" );
+        fprintf( head, "\n" );
+
+        fprintf( head, "inline uint32_t Wayland::Direct::%s::directVersion() const {\n", interfaceName );
+        fprintf( head, "    return resourceVersion();\n" );
+        fprintf( head, "}\n" );
+
+        for (const WaylandEvent& e : interface.requests) {
+            printDirectRequest( head, interface, e, direct );
+        }
+
+        for (const WaylandEvent& e : interface.events) {
+            printDirectEvent( head, interface, e, direct );
+        }
+    }
+}
+
+
+void Wayland::Scribe::printDirectClass( FILE *head, const WaylandInterface& interface ) {
+    std::string interfaceNameBA = snakeCaseToCamelCase( interface.name, true );
+    const char  *interfaceName  = interfaceNameBA.data();
+    const char  *objectName     = interface.name.c_str();
+
+    fprintf( head, "    class %s : public Object, public Wayland::Server::%s::DirectPeer, public Wayland::Client::%s::DirectPeer {\n", interfaceName, interfaceName, interfaceName );
+    fprintf( head, "    public:\n" );
+    fprintf( head, "        explicit %s(Connection *connection);\n", interfaceName );
+    fprintf( head, "        ~%s() override;\n",                      interfaceName );
+    fprintf( head, "\n" );
+    fprintf( head, "        // Binds a resource of global for connection; initialize a Client::%s with the result.\n", interfaceName );
+    fprintf( head, "        static struct ::%s *bind(Connection *connection, Wayland::Server::%s *global, int version);\n", objectName, interfaceName );
+    fprintf( head, "\n" );
+    fprintf( head, "        // Connects a resource created by the server, e.g. for a new_id argument of an event.\n" );
+    fprintf( head, "        static struct ::%s *adopt(Connection *connection, struct ::wl_resource *handle);\n", objectName );
+    fprintf( head, "\n" );
+    fprintf( head, "        struct ::%s *object() { return static_cast<struct ::%s *>(token()); }\n", objectName, objectName );
+    fprintf( head, "\n" );
+    fprintf( head, "        void directBind(struct ::wl_resource *handle) override;\n" );
+    fprintf( head, "        void directAttach(Wayland::Client::%s *clientObject) override;\n", interfaceName );
+    fprintf( head, "        Wayland::Client::%s *directObject() const override;\n",          interfaceName );
+    fprintf( head, "        uint32_t directVersion() const override;\n" );
+
+    if ( !interface.requests.empty() ) {
+        fprintf( head, "\n" );
+
+        for (const WaylandEvent& e : interface.requests) {
+            fprintf( head, "        %s", requestReturnType( e ).c_str() );
+            printEvent( head, e );
+            fprintf( head, " override;\n" );
+        }
+    }
+
+    if ( !interface.events.empty() ) {
+        fprintf( head, "\n" );
+
+        /** The server-side signatures of the events */
+        for (const WaylandEvent& e : interface.events) {
+            fprintf( head, "        void send" );
+            printEvent( head, e, true, false, false, true );
+            fprintf( head, " override;\n" );
+        }
+    }
+
+    fprintf( head, "\n" );
+    fprintf( head, "    private:\n" );
+    fprintf( head, "        Wayland::Client::%s *m_clientObject = nullptr;\n", interfaceName );
+    fprintf( head, "    };\n" );
+}
+
+
+void Wayland::Scribe::printDirectRequest( FILE *head, const WaylandInterface& interface, const WaylandEvent& e, const std::set<std::string>& direct ) {
+    std::string interfaceNameBA = snakeCaseToCamelCase( interface.name, true );
+    const char  *interfaceName  = interfaceNameBA.data();
+
+    const WaylandArgument *new_id = newIdArgument( e.arguments );
+
+    fprintf( head, "\n" );
+    fprintf( head, "inline %sWayland::Direct::%s::", requestReturnType( e ).c_str(), interfaceName );
+
+    /** Untyped new_id arguments are only used by wl_registry::bind, which has no server class */
+    if ( new_id && new_id->interface.empty() ) {
+        printEvent( head, e, true );
+        fprintf( head, " {\n" );
+        fprintf( head, "    return nullptr;\n" );
+        fprintf( head, "}\n" );
+        return;
+    }
+
+    printEvent( head, e );
+    fprintf( head, " {\n" );
+
+    /** Arguments of the server handler: resources instead of tokens, and a copy of each fd as if it was received */
+    std::string args;
+
+    for (const WaylandArgument& a : e.arguments) {
+        args += ", ";
+
+        if ( a.type == "new_id" ) {
+            args += "newId";
+        }
+
+        else if ( a.type == "object" ) {
+            args += "Wayland::Direct::Object::resourceOf(" + a.name + ")";
+        }
+
+        else if ( a.type == "fd" ) {
+            args += "dup(" + a.name + ")";
+        }
+
+        else {
+            args += a.name;
+        }
+    }
+
+    std::string handler = "Wayland::Server::" + std::string( interfaceName ) + "::handle" + snakeCaseToCamelCase( e.name, true );
+
+    if ( new_id && direct.count( new_id->interface ) ) {
+        std::string newIdNameBA = snakeCaseToCamelCase( new_id->interface, true );
+        const char  *newIdName  = newIdNameBA.c_str();
+
+        fprintf( head, "    Wayland::Direct::%s *direct = new Wayland::Direct::%s(connection());\n", newIdName, newIdName );
+        fprintf( head, "\n" );
+        fprintf( head, "    if (resource()) {\n" );
+        fprintf( head, "        uint32_t newId = connection()->newId();\n" );
+        fprintf( head, "\n" );
+        fprintf( head, "        Wayland::Server::%s::expectDirect(connection()->client(), newId, direct);\n", newIdName );
+        fprintf( head, "        %s(connection()->client(), resource()%s);\n",                                 handler.c_str(), args.c_str() );
+        fprintf( head, "        Wayland::Server::%s::expectDirect(connection()->client(), newId, nullptr);\n", newIdName );
+        fprintf( head, "        connection()->settleId(newId);\n" );
+        fprintf( head, "    }\n" );
+        fprintf( head, "\n" );
+        fprintf( head, "    // The handler declined to create the object\n" );
+        fprintf( head, "    if (!direct->resource()) {\n" );
+        fprintf( head, "        connection()->release(direct);\n" );
+        fprintf( head, "        return nullptr;\n" );
+        fprintf( head, "    }\n" );
+        fprintf( head, "\n" );
+        fprintf( head, "    return direct->object();\n" );
+        fprintf( head, "}\n" );
+        return;
+    }
+
+    if ( new_id ) {
+        fprintf( head, "    // %s is not part of this protocol: the new object is not connected\n", new_id->interface.c_str() );
+        fprintf( head, "    if (resource()) {\n" );
+        fprintf( head, "        uint32_t newId = connection()->newId();\n" );
+        fprintf( head, "        %s(connection()->client(), resource()%s);\n", handler.c_str(), args.c_str() );
+        fprintf( head, "        connection()->settleId(newId);\n" );
+        fprintf( head, "    }\n" );
+        fprintf( head, "\n" );
+        fprintf( head, "    return nullptr;\n" );
+        fprintf( head, "}\n" );
+        return;
+    }
+
+    fprintf( head, "    if (resource())\n" );
+    fprintf( head, "        %s(connection()->client(), resource()%s);\n", handler.c_str(), args.c_str() );
+
+    if ( e.type == "destructor" ) {
+        fprintf( head, "\n" );
+        fprintf( head, "    dispose();\n" );
+    }
+
+    fprintf( head, "}\n" );
+}
+
+
+void Wayland::Scribe::printDirectEvent( FILE *head, const WaylandInterface& interface, const WaylandEvent& e, const std::set<std::string>& direct ) {
+    std::string interfaceNameBA = snakeCaseToCamelCase( interface.name, true );
+    const char  *interfaceName  = interfaceNameBA.data();
+
+    fprintf( head, "\n" );
+    fprintf( head, "inline void Wayland::Direct::%s::send", interfaceName );
+
+    printEvent( head, e, true, false, false, true );
+
+    fprintf( head, " {\n" );
+
+    /**
+     * Arguments of the client handler, now and when queued: tokens instead of resources,
+     * a copy of each fd as if it was received, and copies of strings and arrays.
+     */
+    std::string              args;
+    std::string              queuedArgs;
+    std::string              captures = "this";
+    std::vector<std::string> fds;
+    bool                     locals = false;
+
+    for (const WaylandArgument& a : e.arguments) {
+        std::string local = snakeCaseToCamelCase( a.name, false ) + ( a.type == "fd" ? "Dup" : "Object" );
+
+        if ( a.type == "object" ) {
+            fprintf( head, "    %s%s = static_cast<%s>(Wayland::Direct::Object::tokenOf(%s));\n", clientObjectType( a.interface ).c_str(), local.c_str(), clientObjectType( a.interface ).c_str(), a.name.c_str() );
+        }
+
+        else if ( a.type == "new_id" ) {
+            if ( direct.count( a.interface ) ) {
+                fprintf( head, "    %s%s = Wayland::Direct::%s::adopt(connection(), %s);\n", clientObjectType( a.interface ).c_str(), local.c_str(), snakeCaseToCamelCase( a.interface, true ).c_str(), a.name.c_str() );
+            }
+
+            else {
+                fprintf( head, "    %s%s = nullptr;\n", clientObjectType( a.interface ).c_str(), local.c_str() );
+            }
+        }
+
+        else if ( a.type == "fd" ) {
+            fprintf( head, "    int32_t %s = dup(%s);\n", local.c_str(), a.name.c_str() );
+            fds.push_back( local );
+        }
+
+        else if ( a.type == "string" ) {
+            args         += ", " + a.name;
+            queuedArgs   += ", " + a.name + ".get()";
+            captures     += ", " + a.name + " = Wayland::Direct::String(" + a.name + ")";
+            continue;
+        }
+
+        else if ( a.type == "array" ) {
+            args         += ", " + a.name;
+            queuedArgs   += ", " + a.name + ".get()";
+            captures     += ", " + a.name + " = Wayland::Direct::Array(" + a.name + ")";
+            continue;
+        }
+
+        else {
+            args         += ", " + a.name;
+            queuedArgs   += ", " + a.name;
+            captures     += ", " + a.name;
+            continue;
+        }
+
+        locals        = true;
+        args         += ", " + local;
+        queuedArgs   += ", " + local;
+        captures     += ", " + local;
+    }
+
+    std::string handler = "Wayland::Client::" + std::string( interfaceName ) + "::handle" + snakeCaseToCamelCase( e.name, true );
+
+    if ( locals ) {
+        fprintf( head, "\n" );
+    }
+
+    /** Dropped events release the fds they hold; this may be gone then */
+    fprintf( head, "    if (!m_clientObject || connection()->queued()) {\n" );
+    fprintf( head, "        queueEvent([%s](bool deliver) {\n",      captures.c_str() );
+    fprintf( head, "            if (deliver && m_clientObject)\n" );
+    fprintf( head, "                %s(m_clientObject, object()%s);\n", handler.c_str(), queuedArgs.c_str() );
+
+    if ( fds.size() == 1 ) {
+        fprintf( head, "            else\n" );
+        fprintf( head, "                close(%s);\n", fds.front().c_str() );
+    }
+
+    else if ( fds.size() ) {
+        fprintf( head, "            else {\n" );
+
+        for (const std::string& fd : fds) {
+            fprintf( head, "                close(%s);\n", fd.c_str() );
+        }
+
+        fprintf( head, "            }\n" );
+    }
+
+    fprintf( head, "        });\n" );
+    fprintf( head, "        return;\n" );
+    fprintf( head, "    }\n" );
+    fprintf( head, "\n" );
+    fprintf( head, "    %s(m_clientObject, object()%s);\n", handler.c_str(), args.c_str() );
+    fprintf( head, "}\n" );
+}
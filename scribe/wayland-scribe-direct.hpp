@@ -0,0 +1,369 @@
+/**
+ * This file contains the runtime of the in-process shim generated with
+ * `wayland-scribe --emit-direct`.
+ *
+ * A Connection is a real wl_client of the compositor's wl_display, so
+ * the server classes keep working on real wl_resources. The objects of
+ * the shim connect a server resource with a client object: requests call
+ * the generated server handlers, and events call the generated client
+ * handlers, with the same argument conversions but no marshalling. The
+ * socket of the connection is not used for them.
+ *
+ * libwayland still writes to the socket what it sends outside of the
+ * shim: wl_display.delete_id for every destroyed object, and the events
+ * of resources without a direct object. The connection discards all of
+ * it in flush(), which runs on dispatch() and every few destroyed
+ * objects, so that long-running loops do not fill the socket.
+ *
+ * Events are delivered immediately, unless they are sent to an object
+ * whose client object is not attached yet: then they, and all the events
+ * after them, are queued until Connection::dispatch(), which plays the
+ * part of wl_display_dispatch(). Events of objects that are not attached
+ * when dispatched are dropped, as libwayland drops the events of proxies
+ * without a listener.
+ *
+ * On the client side, the token of a direct object stands in for its
+ * wl_proxy: it is returned by the requests that create objects, it is
+ * passed to the constructor or init() of the client class, and it is
+ * used as object argument of requests. It is not a wl_proxy, and must
+ * not be passed to libwayland.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the FSF website:
+ * https://www.gnu.org/licenses/gpl-3.0.html#license-text
+ **/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <unordered_set>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <wayland-server-core.h>
+
+namespace Wayland {
+    namespace Direct {
+        class Object;
+
+        class Connection {
+            public:
+                /** Creates a client of @display; the other end of its socket is kept open, but unused */
+                explicit Connection( struct ::wl_display *display );
+                ~Connection();
+
+                Connection( const Connection& )            = delete;
+                Connection& operator=( const Connection& ) = delete;
+
+                /** nullptr if the client could not be created, or has been destroyed with the display */
+                struct ::wl_client *client() const {
+                    return mClient;
+                }
+
+                /** Ids are handed out in sequence after wl_display (1), as libwayland expects them */
+                uint32_t newId() {
+                    return mNextId++;
+                }
+
+                /**
+                 * libwayland rejects ids past the end of the object map of the client: when the
+                 * server did not create an object with @id, a placeholder is created and destroyed
+                 * there, so that later ids are accepted.
+                 */
+                void settleId( uint32_t id );
+
+                /** Objects are owned by the connection, and deleted with it at the latest */
+                void adopt( Object *object );
+                void release( Object *object );
+
+                /** Events wait in order while any is queued */
+                bool queued() const {
+                    return !mQueue.empty();
+                }
+
+                /** @event is called with false instead when it is dropped, to release what it holds */
+                void queue( Object *object, std::function<void( bool )> event );
+
+                /** Delivers the queued events, including those queued meanwhile */
+                void dispatch();
+
+                /** Discards what libwayland wrote to the socket of the client */
+                void flush();
+
+            private:
+                struct QueuedEvent {
+                    Object                      *object;
+                    std::function<void( bool )> deliver;
+                };
+
+                /** Objects released between two flushes */
+                static constexpr uint32_t FlushInterval = 64;
+
+                struct ClientDestroyedListener : ::wl_listener {
+                    Connection *parent;
+                };
+
+                static void clientDestroyed( struct ::wl_listener *listener, void * );
+
+                struct ::wl_client           *mClient  = nullptr;
+                int                          mPeerFd   = -1;
+                uint32_t                     mNextId   = 2;
+                uint32_t                     mReleased = 0;
+                ClientDestroyedListener      mClientDestroyedListener;
+                std::unordered_set<Object *> mObjects;
+                std::vector<QueuedEvent>     mQueue;
+        };
+
+        class Object {
+            public:
+                explicit Object( Connection *connection );
+                virtual ~Object();
+
+                Object( const Object& )            = delete;
+                Object& operator=( const Object& ) = delete;
+
+                Connection *connection() const {
+                    return mConnection;
+                }
+
+                /** nullptr until the server has created the resource, and once it is destroyed */
+                struct ::wl_resource *resource() const {
+                    return mResource;
+                }
+
+                uint32_t resourceVersion() const {
+                    return mVersion;
+                }
+
+                /** Stands in for the wl_proxy of this object in the client code */
+                void *token() {
+                    return this;
+                }
+
+                /** Resource of the object @token stands in for */
+                static struct ::wl_resource *resourceOf( const void *token ) {
+                    return token ? static_cast<const Object *>( token )->mResource : nullptr;
+                }
+
+                /** Token of the direct object of @resource; nullptr for other resources */
+                static void *tokenOf( struct ::wl_resource *resource );
+
+                /** Connects this object with the resource created for it by the server */
+                void setResource( struct ::wl_resource *resource );
+
+            protected:
+                void queueEvent( std::function<void( bool )> event ) {
+                    mConnection->queue( this, std::move( event ) );
+                }
+
+                /** Deletes this object */
+                void dispose();
+
+            private:
+                struct DestroyListener : ::wl_listener {
+                    Object *parent;
+                };
+
+                static void resourceDestroyed( struct ::wl_listener *listener, void * );
+
+                Connection           *mConnection;
+                struct ::wl_resource *mResource = nullptr;
+                uint32_t             mVersion   = 0;
+                DestroyListener      mDestroyListener;
+        };
+
+        /** Copy of a string argument, for queued events */
+        class String {
+            public:
+                String( const char *str ) : mNull( str == nullptr ), mValue( str ? str : "" ) {}
+
+                const char *get() const {
+                    return mNull ? nullptr : mValue.c_str();
+                }
+
+            private:
+                bool        mNull;
+                std::string mValue;
+        };
+
+        /** Copy of an array argument, for queued events */
+        class Array {
+            public:
+                Array( const struct ::wl_array *array ) : mNull( array == nullptr ) {
+                    if ( array && array->size ) {
+                        mData.assign( static_cast<const char *>( array->data ), static_cast<const char *>( array->data ) + array->size );
+                    }
+                }
+
+                struct ::wl_array *get() const {
+                    mArray.size  = mData.size();
+                    mArray.alloc = 0;
+                    mArray.data  = mData.data();
+
+                    return mNull ? nullptr : &mArray;
+                }
+
+            private:
+                bool                      mNull;
+                mutable std::vector<char> mData;
+                mutable struct ::wl_array mArray;
+        };
+
+        inline Connection::Connection( struct ::wl_display *display ) {
+            int fds[ 2 ];
+
+            if ( socketpair( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds ) != 0 ) {
+                return;
+            }
+
+            mClient = wl_client_create( display, fds[ 0 ] );
+            mPeerFd = fds[ 1 ];
+
+            if ( mClient ) {
+                mClientDestroyedListener.notify = clientDestroyed;
+                mClientDestroyedListener.parent = this;
+                wl_client_add_destroy_listener( mClient, &mClientDestroyedListener );
+            }
+        }
+
+        inline Connection::~Connection() {
+            /** Resources go first: their destructors may still send events to the objects */
+            if ( mClient ) {
+                wl_client_destroy( mClient );
+            }
+
+            for ( QueuedEvent& event : mQueue ) {
+                event.deliver( false );
+            }
+
+            for ( Object *object : mObjects ) {
+                delete object;
+            }
+
+            if ( mPeerFd >= 0 ) {
+                close( mPeerFd );
+            }
+        }
+
+        inline void Connection::adopt( Object *object ) {
+            mObjects.insert( object );
+        }
+
+        inline void Connection::release( Object *object ) {
+            if ( !mObjects.erase( object ) ) {
+                return;
+            }
+
+            /** Entries are only cleared: dispatch() may be walking the queue */
+            for ( QueuedEvent& event : mQueue ) {
+                if ( event.object == object ) {
+                    event.object = nullptr;
+                }
+            }
+
+            delete object;
+
+            /** Every destroyed object of the client queues a wl_display.delete_id */
+            if ( ++mReleased % FlushInterval == 0 ) {
+                flush();
+            }
+        }
+
+        inline void Connection::settleId( uint32_t id ) {
+            static const struct ::wl_interface placeholderInterface = { "wayland_scribe_placeholder", 1, 0, nullptr, 0, nullptr };
+
+            if ( !mClient || wl_client_get_object( mClient, id ) ) {
+                return;
+            }
+
+            struct ::wl_resource *placeholder = wl_resource_create( mClient, &placeholderInterface, 1, id );
+
+            if ( placeholder ) {
+                wl_resource_destroy( placeholder );
+            }
+        }
+
+        inline void Connection::queue( Object *object, std::function<void( bool )> event ) {
+            mQueue.push_back( { object, std::move( event ) } );
+        }
+
+        inline void Connection::dispatch() {
+            for ( size_t i = 0; i < mQueue.size(); i++ ) {
+                QueuedEvent event = std::move( mQueue[ i ] );
+
+                event.deliver( event.object != nullptr );
+            }
+
+            mQueue.clear();
+            flush();
+        }
+
+        inline void Connection::flush() {
+            char buffer[ 4096 ];
+
+            if ( !mClient ) {
+                return;
+            }
+
+            wl_client_flush( mClient );
+
+            /** Ancillary data is not received: fds sent along are closed by the kernel */
+            while ( recv( mPeerFd, buffer, sizeof( buffer ), MSG_DONTWAIT ) > 0 ) {
+            }
+        }
+
+        inline void Connection::clientDestroyed( struct ::wl_listener *listener, void * ) {
+            static_cast<ClientDestroyedListener *>( listener )->parent->mClient = nullptr;
+        }
+
+        inline Object::Object( Connection *connection ) : mConnection( connection ) {
+            mDestroyListener.notify = resourceDestroyed;
+            mDestroyListener.parent = this;
+
+            mConnection->adopt( this );
+        }
+
+        inline Object::~Object() {
+            if ( mResource ) {
+                wl_list_remove( &mDestroyListener.link );
+            }
+        }
+
+        inline void *Object::tokenOf( struct ::wl_resource *resource ) {
+            struct ::wl_listener *listener = ( resource ? wl_resource_get_destroy_listener( resource, resourceDestroyed ) : nullptr );
+
+            return listener ? static_cast<DestroyListener *>( listener )->parent : nullptr;
+        }
+
+        inline void Object::setResource( struct ::wl_resource *resource ) {
+            if ( !resource ) {
+                return;
+            }
+
+            mResource = resource;
+            mVersion  = wl_resource_get_version( resource );
+            wl_resource_add_destroy_listener( resource, &mDestroyListener );
+        }
+
+        inline void Object::dispose() {
+            mConnection->release( this );
+        }
+
+        inline void Object::resourceDestroyed( struct ::wl_listener *listener, void * ) {
+            static_cast<DestroyListener *>( listener )->parent->mResource = nullptr;
+        }
+    }
+}
@@ -0,0 +1,468 @@
+/**
+ * This file contains the shared-memory statistics segment used by the
+ * code generated with `wayland-scribe --stats`, and by the
+ * `wayland-scribe-top` viewer.
+ *
+ * The instrumented process (compositor or client) creates a POSIX
+ * shared-memory segment, named `/wayland-scribe-<pid>` by default, and
+ * publishes per-interface, per-opcode and per-client message counters
+ * into it. All updates are guarded by a seqlock: writers serialize on
+ * the sequence counter, and readers retry until they observe a stable,
+ * even sequence. Readers map the segment read-only; no IPC with the
+ * instrumented process is needed.
+ *
+ * The environment variable WAYLAND_SCRIBE_STATS can be used to override
+ * the segment name, or set to 0 to disable publishing at runtime.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the FSF website:
+ * https://www.gnu.org/licenses/gpl-3.0.html#license-text
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+namespace Wayland {
+    namespace Stats {
+        /** "WSST" */
+        constexpr uint32_t Magic         = 0x57535354;
+        constexpr uint32_t LayoutVersion = 3;
+
+        constexpr uint32_t MaxInterfaces = 128;
+        constexpr uint32_t MaxOpcodes    = 32;
+        constexpr uint32_t MaxClients    = 128;
+        constexpr uint32_t NameLength    = 64;
+        constexpr uint32_t MessageLength = 32;
+
+        /** Minimum interval between two scans for the slots of exited peers, in nanoseconds */
+        constexpr int64_t ReclaimInterval = 1000000000;
+
+        /** Returned by interfaceSlot() when publishing is disabled, or the table is full */
+        constexpr uint32_t NoSlot = UINT32_MAX;
+
+        enum Direction {
+            Request = 0,
+            Event   = 1,
+        };
+
+        static_assert( std::atomic<uint32_t>::is_always_lock_free, "Shared-memory counters need lock-free 32-bit atomics" );
+        static_assert( std::atomic<uint64_t>::is_always_lock_free, "Shared-memory counters need lock-free 64-bit atomics" );
+
+        /**
+         * Counters of one interface.
+         * Opcodes beyond MaxOpcodes - 1 are accumulated in the last bucket.
+         */
+        struct InterfaceEntry {
+            char                  name[ NameLength ];
+            std::atomic<uint64_t> messages[ 2 ][ MaxOpcodes ];
+
+            /** Names of the messages, empty when unknown; the last one may stand for several opcodes */
+            char                  messageNames[ 2 ][ MaxOpcodes ][ MessageLength ];
+        };
+
+        /**
+         * Message totals of one peer process, keyed by pid.
+         * A pid of 0 marks an empty slot.
+         */
+        struct ClientEntry {
+            std::atomic<int32_t>  pid;
+            std::atomic<uint64_t> messages[ 2 ];
+        };
+
+        struct Segment {
+            uint32_t              magic;
+            uint32_t              version;
+            int32_t               owner;
+
+            /** Seqlock: odd while a writer is updating the segment */
+            std::atomic<uint32_t> sequence;
+
+            std::atomic<uint32_t> interfaceCount;
+            InterfaceEntry        interfaces[ MaxInterfaces ];
+            ClientEntry           clients[ MaxClients ];
+
+            /** Totals of the peers that found the client table full */
+            ClientEntry           otherClients;
+        };
+
+        /** Plain copy of a segment, as taken by snapshot() */
+        struct Snapshot {
+            int32_t  owner = 0;
+            uint32_t interfaceCount = 0;
+
+            struct Interface {
+                char     name[ NameLength ];
+                uint64_t messages[ 2 ][ MaxOpcodes ];
+                char     messageNames[ 2 ][ MaxOpcodes ][ MessageLength ];
+            } interfaces[ MaxInterfaces ];
+
+            struct Client {
+                int32_t  pid;
+                uint64_t messages[ 2 ];
+            } clients[ MaxClients ];
+
+            Client otherClients;
+        };
+
+        /** Default name of the segment published by the process @pid */
+        inline std::string segmentName( int32_t pid ) {
+            return "/wayland-scribe-" + std::to_string( pid );
+        }
+
+        namespace Private {
+            inline std::string& publishedName() {
+                static std::string name;
+
+                return name;
+            }
+
+            /** Forked children inherit the atexit() handler, but must not remove the segment of their parent */
+            inline int32_t& publishedOwner() {
+                static int32_t owner = 0;
+
+                return owner;
+            }
+
+            inline void unlinkSegment() {
+                if ( !publishedName().empty() && ( publishedOwner() == getpid() ) ) {
+                    shm_unlink( publishedName().c_str() );
+                }
+            }
+
+            inline Segment *createSegment() {
+                std::string name = segmentName( getpid() );
+                const char  *env = getenv( "WAYLAND_SCRIBE_STATS" );
+
+                if ( env && ( strcmp( env, "0" ) == 0 ) ) {
+                    return nullptr;
+                }
+
+                else if ( env && ( env[ 0 ] == '/' ) ) {
+                    name = env;
+                }
+
+                int fd = shm_open( name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600 );
+
+                if ( fd < 0 ) {
+                    return nullptr;
+                }
+
+                if ( ftruncate( fd, sizeof( Segment ) ) != 0 ) {
+                    close( fd );
+                    shm_unlink( name.c_str() );
+                    return nullptr;
+                }
+
+                void *mem = mmap( nullptr, sizeof( Segment ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+
+                close( fd );
+
+                if ( mem == MAP_FAILED ) {
+                    shm_unlink( name.c_str() );
+                    return nullptr;
+                }
+
+                /** The mapping is zero-filled: only the header needs to be set */
+                Segment *seg = static_cast<Segment *>( mem );
+
+                seg->magic   = Magic;
+                seg->version = LayoutVersion;
+                seg->owner   = getpid();
+
+                publishedName()  = name;
+                publishedOwner() = seg->owner;
+                atexit( unlinkSegment );
+
+                return seg;
+            }
+
+            inline Segment *segment() {
+                static Segment *seg = createSegment();
+
+                return seg;
+            }
+
+            inline void increment( std::atomic<uint64_t>& counter ) {
+                /** Writers are serialized by the seqlock, a plain read-modify-write suffices */
+                counter.store( counter.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            }
+
+            inline uint32_t writeLock( Segment *seg ) {
+                uint32_t seq = seg->sequence.load( std::memory_order_relaxed );
+
+                while ( true ) {
+                    if ( ( seq & 1 ) == 0 ) {
+                        if ( seg->sequence.compare_exchange_weak( seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed ) ) {
+                            break;
+                        }
+                    }
+
+                    else {
+                        seq = seg->sequence.load( std::memory_order_relaxed );
+                    }
+                }
+
+                /** Make the odd sequence visible before any of the counter updates */
+                std::atomic_thread_fence( std::memory_order_release );
+
+                return seq;
+            }
+
+            inline void writeUnlock( Segment *seg, uint32_t seq ) {
+                seg->sequence.store( seq + 2, std::memory_order_release );
+            }
+
+            inline int64_t monotonicTime() {
+                struct timespec ts;
+
+                clock_gettime( CLOCK_MONOTONIC, &ts );
+
+                return int64_t( ts.tv_sec ) * 1000000000 + ts.tv_nsec;
+            }
+
+            /** Called with the seqlock held, so a plain static suffices */
+            inline int64_t& nextReclaim() {
+                static int64_t next = 0;
+
+                return next;
+            }
+
+            inline ClientEntry *clientEntry( Segment *seg, int32_t pid ) {
+                uint32_t start = uint32_t( pid ) * 2654435761u % MaxClients;
+
+                /** Linear probing: entries are never removed, only recycled in place */
+                for ( uint32_t i = 0; i < MaxClients; i++ ) {
+                    ClientEntry *entry = &seg->clients[ ( start + i ) % MaxClients ];
+                    int32_t     owner  = entry->pid.load( std::memory_order_relaxed );
+
+                    if ( owner == pid ) {
+                        return entry;
+                    }
+
+                    if ( owner == 0 ) {
+                        entry->pid.store( pid, std::memory_order_relaxed );
+                        return entry;
+                    }
+                }
+
+                /**
+                 * Table is full: the peer is counted in the shared overflow slot.
+                 * Scanning for exited processes costs a syscall per slot, so it is
+                 * done at most once per ReclaimInterval.
+                 */
+                int64_t now = monotonicTime();
+
+                if ( now < nextReclaim() ) {
+                    return &seg->otherClients;
+                }
+
+                nextReclaim() = now + ReclaimInterval;
+
+                for ( ClientEntry& entry : seg->clients ) {
+                    if ( ( kill( entry.pid.load( std::memory_order_relaxed ), 0 ) != 0 ) && ( errno == ESRCH ) ) {
+                        entry.pid.store( pid, std::memory_order_relaxed );
+                        entry.messages[ Request ].store( 0, std::memory_order_relaxed );
+                        entry.messages[ Event ].store( 0, std::memory_order_relaxed );
+                        return &entry;
+                    }
+                }
+
+                return &seg->otherClients;
+            }
+        }
+
+        namespace Private {
+            inline void setMessageNames( InterfaceEntry& entry, Direction direction, const char *const *names, uint32_t count ) {
+                for ( uint32_t op = 0; ( op < count ) && ( op < MaxOpcodes ); op++ ) {
+                    char *dest = entry.messageNames[ direction ][ op ];
+
+                    /** Opcodes beyond the last bucket are accumulated in it */
+                    const char *src = ( ( op == MaxOpcodes - 1 ) && ( count > MaxOpcodes ) ? "(others)" : names[ op ] );
+
+                    if ( dest[ 0 ] == '\0' ) {
+                        strncpy( dest, src, MessageLength - 1 );
+                    }
+                }
+            }
+        }
+
+        /**
+         * Slot of the interface @name in the segment, registering it on first use.
+         * Generated code looks this up once per interface and caches it, and
+         * passes the names of the requests and events, indexed by opcode.
+         */
+        inline uint32_t interfaceSlot( const char *name, const char *const *requests = nullptr, uint32_t requestCount = 0, const char *const *events = nullptr, uint32_t eventCount = 0 ) {
+            Segment *seg = Private::segment();
+
+            if ( !seg ) {
+                return NoSlot;
+            }
+
+            uint32_t seq   = Private::writeLock( seg );
+            uint32_t count = seg->interfaceCount.load( std::memory_order_relaxed );
+            uint32_t slot  = NoSlot;
+
+            for ( uint32_t i = 0; i < count; i++ ) {
+                if ( strncmp( seg->interfaces[ i ].name, name, NameLength - 1 ) == 0 ) {
+                    slot = i;
+                    break;
+                }
+            }
+
+            if ( ( slot == NoSlot ) && ( count < MaxInterfaces ) ) {
+                strncpy( seg->interfaces[ count ].name, name, NameLength - 1 );
+                seg->interfaceCount.store( count + 1, std::memory_order_relaxed );
+                slot = count;
+            }
+
+            if ( slot != NoSlot ) {
+                Private::setMessageNames( seg->interfaces[ slot ], Request, requests, requestCount );
+                Private::setMessageNames( seg->interfaces[ slot ], Event,   events,   eventCount );
+            }
+
+            Private::writeUnlock( seg, seq );
+
+            return slot;
+        }
+
+        /**
+         * Account one message of @opcode on the interface @slot.
+         * @pid is the peer process; 0 skips the per-client totals.
+         */
+        inline void count( uint32_t slot, uint32_t opcode, Direction direction, int32_t pid ) {
+            if ( slot == NoSlot ) {
+                return;
+            }
+
+            Segment  *seg = Private::segment();
+            uint32_t seq  = Private::writeLock( seg );
+
+            Private::increment( seg->interfaces[ slot ].messages[ direction ][ opcode < MaxOpcodes ? opcode : MaxOpcodes - 1 ] );
+
+            if ( pid > 0 ) {
+                Private::increment( Private::clientEntry( seg, pid )->messages[ direction ] );
+            }
+
+            Private::writeUnlock( seg, seq );
+        }
+
+        /**
+         * Map the segment @name read-only.
+         * Returns nullptr if it does not exist, or has an unknown layout.
+         */
+        inline const Segment *attach( const std::string& name ) {
+            int fd = shm_open( name.c_str(), O_RDONLY, 0 );
+
+            if ( fd < 0 ) {
+                return nullptr;
+            }
+
+            void *mem = mmap( nullptr, sizeof( Segment ), PROT_READ, MAP_SHARED, fd, 0 );
+
+            close( fd );
+
+            if ( mem == MAP_FAILED ) {
+                return nullptr;
+            }
+
+            const Segment *seg = static_cast<const Segment *>( mem );
+
+            if ( ( seg->magic != Magic ) || ( seg->version != LayoutVersion ) ) {
+                munmap( mem, sizeof( Segment ) );
+                return nullptr;
+            }
+
+            return seg;
+        }
+
+        inline void detach( const Segment *seg ) {
+            munmap( const_cast<Segment *>( seg ), sizeof( Segment ) );
+        }
+
+        /**
+         * Take a consistent copy of @seg; spins while a writer is active.
+         * Returns false if the owner died while holding the seqlock: the
+         * segment then stays locked forever, and @snap is not updated.
+         */
+        inline bool snapshot( const Segment *seg, Snapshot& snap ) {
+            uint32_t before, after;
+            uint32_t spins = 0;
+
+            do {
+                before = seg->sequence.load( std::memory_order_acquire );
+
+                if ( before & 1 ) {
+                    /** Writers hold the lock for a few stores only: check the owner now and then */
+                    if ( ( ++spins % 4096 == 0 ) && ( kill( seg->owner, 0 ) != 0 ) && ( errno == ESRCH ) ) {
+                        return false;
+                    }
+
+                    continue;
+                }
+
+                snap.owner          = seg->owner;
+                snap.interfaceCount = seg->interfaceCount.load( std::memory_order_relaxed );
+
+                /** The segment is writable by its owner, which is not trusted here */
+                if ( snap.interfaceCount > MaxInterfaces ) {
+                    snap.interfaceCount = MaxInterfaces;
+                }
+
+                for ( uint32_t i = 0; i < snap.interfaceCount; i++ ) {
+                    memcpy( snap.interfaces[ i ].name,         seg->interfaces[ i ].name,         NameLength );
+                    memcpy( snap.interfaces[ i ].messageNames, seg->interfaces[ i ].messageNames, sizeof( snap.interfaces[ i ].messageNames ) );
+
+                    for ( uint32_t op = 0; op < MaxOpcodes; op++ ) {
+                        snap.interfaces[ i ].messages[ Request ][ op ] = seg->interfaces[ i ].messages[ Request ][ op ].load( std::memory_order_relaxed );
+                        snap.interfaces[ i ].messages[ Event ][ op ]   = seg->interfaces[ i ].messages[ Event ][ op ].load( std::memory_order_relaxed );
+                    }
+                }
+
+                for ( uint32_t i = 0; i < MaxClients; i++ ) {
+                    snap.clients[ i ].pid                 = seg->clients[ i ].pid.load( std::memory_order_relaxed );
+                    snap.clients[ i ].messages[ Request ] = seg->clients[ i ].messages[ Request ].load( std::memory_order_relaxed );
+                    snap.clients[ i ].messages[ Event ]   = seg->clients[ i ].messages[ Event ].load( std::memory_order_relaxed );
+                }
+
+                snap.otherClients.pid                 = 0;
+                snap.otherClients.messages[ Request ] = seg->otherClients.messages[ Request ].load( std::memory_order_relaxed );
+                snap.otherClients.messages[ Event ]   = seg->otherClients.messages[ Event ].load( std::memory_order_relaxed );
+
+                std::atomic_thread_fence( std::memory_order_acquire );
+                after = seg->sequence.load( std::memory_order_relaxed );
+            } while ( ( before & 1 ) || ( before != after ) );
+
+            for ( uint32_t i = 0; i < snap.interfaceCount; i++ ) {
+                snap.interfaces[ i ].name[ NameLength - 1 ] = '\0';
+
+                for ( uint32_t op = 0; op < MaxOpcodes; op++ ) {
+                    snap.interfaces[ i ].messageNames[ Request ][ op ][ MessageLength - 1 ] = '\0';
+                    snap.interfaces[ i ].messageNames[ Event ][ op ][ MessageLength - 1 ]   = '\0';
+                }
+            }
+
+            return true;
+        }
+    }
+}
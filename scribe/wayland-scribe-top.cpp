@@ -0,0 +1,292 @@
+/**
+ * This file contains the code for wayland-scribe-top.
+ * wayland-scribe-top attaches read-only to the statistics segment
+ * published by code generated with `wayland-scribe --stats`, and shows
+ * the live message rates per interface, per opcode and per client.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, visit the FSF website:
+ * https://www.gnu.org/licenses/gpl-3.0.html#license-text
+ **/
+
+
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include "wayland-scribe-stats.hpp"
+#include "cxxopts.hpp"
+
+namespace WS = Wayland::Stats;
+
+struct Row {
+    std::string name;
+    double      requestRate;
+    double      eventRate;
+    uint64_t    requests;
+    uint64_t    events;
+};
+
+
+void printHelpText( bool err ) {
+    ( err ? std::cerr : std::cout ) << "wayland-scribe-top " << PROJECT_VERSION << std::endl << std::endl;
+
+    ( err ? std::cerr : std::cout ) << "Usage:" << std::endl;
+    ( err ? std::cerr : std::cout ) << "  wayland-scribe-top --pid <pid> [options]" << std::endl;
+    ( err ? std::cerr : std::cout ) << "  wayland-scribe-top --name <segment> [options]" << std::endl << std::endl;
+
+    ( err ? std::cerr : std::cout ) << "Options:" << std::endl;
+    ( err ? std::cerr : std::cout ) << "  -p|--pid <pid>            Watch the segment published by this process." << std::endl;
+    ( err ? std::cerr : std::cout ) << "  -n|--name <segment>       Watch the segment with this name (WAYLAND_SCRIBE_STATS)." << std::endl;
+    ( err ? std::cerr : std::cout ) << "  -i|--interval <seconds>   Refresh interval (default: 1)." << std::endl;
+    ( err ? std::cerr : std::cout ) << "  -l|--lines <count>        Number of rows shown per table (default: 15)." << std::endl;
+    ( err ? std::cerr : std::cout ) << "  -b|--batch                Do not clear the screen between updates." << std::endl << std::endl;
+
+    ( err ? std::cerr : std::cout ) << "Other options:" << std::endl;
+    ( err ? std::cerr : std::cout ) << "  -h|--help                 Print this help text and exit." << std::endl;
+    ( err ? std::cerr : std::cout ) << "  -v|--version              Print version information and exit." << std::endl;
+}
+
+
+static std::string processName( int32_t pid ) {
+    std::ifstream comm( "/proc/" + std::to_string( pid ) + "/comm" );
+    std::string   name;
+
+    if ( !std::getline( comm, name ) ) {
+        name = "?";
+    }
+
+    return name;
+}
+
+
+static void printRows( std::vector<Row>& rows, size_t lines, const char *title ) {
+    std::sort(
+        rows.begin(), rows.end(), [] ( const Row& a, const Row& b ) {
+            if ( a.requestRate + a.eventRate != b.requestRate + b.eventRate ) {
+                return a.requestRate + a.eventRate > b.requestRate + b.eventRate;
+            }
+
+            return a.requests + a.events > b.requests + b.events;
+        }
+    );
+
+    printf( "%-40s %10s %10s %14s %14s\n", title, "req/s", "evt/s", "requests", "events" );
+
+    for ( size_t i = 0; i < std::min( lines, rows.size() ); i++ ) {
+        printf(
+            "%-40s %10.1f %10.1f %14lu %14lu\n", rows[ i ].name.c_str(), rows[ i ].requestRate, rows[ i ].eventRate,
+            (unsigned long)rows[ i ].requests, (unsigned long)rows[ i ].events
+        );
+    }
+
+    printf( "\n" );
+}
+
+
+/** Name of the message @op, or its opcode for segments published without names */
+static std::string messageName( const WS::Snapshot::Interface& iface, WS::Direction direction, uint32_t op ) {
+    const char *name = iface.messageNames[ direction ][ op ];
+
+    return name[ 0 ] ? std::string( name ) : "#" + std::to_string( op );
+}
+
+
+static void printStats( const WS::Snapshot& prev, const WS::Snapshot& curr, double elapsed, size_t lines ) {
+    std::vector<Row> interfaces;
+    std::vector<Row> opcodes;
+    std::vector<Row> clients;
+
+    uint64_t totalRequests = 0, totalEvents = 0;
+    double   requestRate   = 0, eventRate = 0;
+
+    for ( uint32_t i = 0; i < curr.interfaceCount; i++ ) {
+        const auto& now    = curr.interfaces[ i ];
+        const auto& before = prev.interfaces[ i ];
+        bool        known  = i < prev.interfaceCount;
+
+        Row iface = { now.name, 0, 0, 0, 0 };
+
+        for ( uint32_t op = 0; op < WS::MaxOpcodes; op++ ) {
+            uint64_t req = now.messages[ WS::Request ][ op ];
+            uint64_t evt = now.messages[ WS::Event ][ op ];
+
+            double reqRate = ( req - ( known ? before.messages[ WS::Request ][ op ] : 0 ) ) / elapsed;
+            double evtRate = ( evt - ( known ? before.messages[ WS::Event ][ op ] : 0 ) ) / elapsed;
+
+            if ( req ) {
+                opcodes.push_back( { std::string( now.name ) + " request " + messageName( now, WS::Request, op ), reqRate, 0, req, 0 } );
+            }
+
+            if ( evt ) {
+                opcodes.push_back( { std::string( now.name ) + " event " + messageName( now, WS::Event, op ), 0, evtRate, 0, evt } );
+            }
+
+            iface.requests    += req;
+            iface.events      += evt;
+            iface.requestRate += reqRate;
+            iface.eventRate   += evtRate;
+        }
+
+        totalRequests += iface.requests;
+        totalEvents   += iface.events;
+        requestRate   += iface.requestRate;
+        eventRate     += iface.eventRate;
+
+        interfaces.push_back( iface );
+    }
+
+    for ( uint32_t i = 0; i < WS::MaxClients; i++ ) {
+        const auto& now    = curr.clients[ i ];
+        const auto& before = prev.clients[ i ];
+
+        if ( now.pid == 0 ) {
+            continue;
+        }
+
+        /** A recycled slot starts from zero again */
+        bool known = before.pid == now.pid;
+
+        clients.push_back(
+            {
+                std::to_string( now.pid ) + " (" + processName( now.pid ) + ")",
+                ( now.messages[ WS::Request ] - ( known ? before.messages[ WS::Request ] : 0 ) ) / elapsed,
+                ( now.messages[ WS::Event ] - ( known ? before.messages[ WS::Event ] : 0 ) ) / elapsed,
+                now.messages[ WS::Request ],
+                now.messages[ WS::Event ]
+            }
+        );
+    }
+
+    const auto& other = curr.otherClients;
+
+    if ( other.messages[ WS::Request ] || other.messages[ WS::Event ] ) {
+        clients.push_back(
+            {
+                "other",
+                ( other.messages[ WS::Request ] - prev.otherClients.messages[ WS::Request ] ) / elapsed,
+                ( other.messages[ WS::Event ] - prev.otherClients.messages[ WS::Event ] ) / elapsed,
+                other.messages[ WS::Request ],
+                other.messages[ WS::Event ]
+            }
+        );
+    }
+
+    printf( "wayland-scribe-top - %d (%s)\n", curr.owner, processName( curr.owner ).c_str() );
+    printf(
+        "Messages: %lu requests, %lu events; %.1f req/s, %.1f evt/s\n\n", (unsigned long)totalRequests, (unsigned long)totalEvents,
+        requestRate, eventRate
+    );
+
+    printRows( interfaces, lines, "Interface" );
+    printRows( opcodes,    lines, "Message" );
+
+    if ( clients.size() ) {
+        printRows( clients, lines, "Client" );
+    }
+}
+
+
+int main( int argc, char **argv ) {
+    cxxopts::Options options( "wayland-scribe-top", "Live view of the statistics published by wayland-scribe instrumented code." );
+
+    options.add_options()
+    ( "h,help", "Print this help" )
+    ( "v,version", "Print application version and exit" )
+    ( "p,pid", "Process whose segment is to be watched", cxxopts::value<int32_t>() )
+    ( "n,name", "Name of the segment to be watched", cxxopts::value<std::string>() )
+    ( "i,interval", "Refresh interval in seconds", cxxopts::value<double>()->default_value( "1" ) )
+    ( "l,lines", "Rows shown per table", cxxopts::value<size_t>()->default_value( "15" ) )
+    ( "b,batch", "Do not clear the screen between updates" );
+
+    auto result = options.parse( argc, argv );
+
+    if ( result.count( "help" ) ) {
+        printHelpText( false );
+        return 0;
+    }
+
+    if ( result.count( "version" ) ) {
+        std::cout << "wayland-scribe-top " << PROJECT_VERSION << std::endl;
+        return 0;
+    }
+
+    if ( result.count( "pid" ) == result.count( "name" ) ) {
+        std::cerr << "[Error]: Please specify one of --pid or --name" << std::endl << std::endl;
+        printHelpText( true );
+
+        return EXIT_FAILURE;
+    }
+
+    std::string name = ( result.count( "pid" ) ? WS::segmentName( result[ "pid" ].as<int32_t>() ) : result[ "name" ].as<std::string>() );
+
+    const WS::Segment *seg = WS::attach( name );
+
+    if ( !seg ) {
+        std::cerr << "[Error]: Unable to attach to the statistics segment " << name << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    double interval = std::max( result[ "interval" ].as<double>(), 0.1 );
+    size_t lines    = result[ "lines" ].as<size_t>();
+    bool   batch    = result.count( "batch" );
+
+    /** Snapshots are large: keep them off the stack */
+    std::unique_ptr<WS::Snapshot> prev = std::make_unique<WS::Snapshot>();
+    std::unique_ptr<WS::Snapshot> curr = std::make_unique<WS::Snapshot>();
+
+    if ( !WS::snapshot( seg, *prev ) ) {
+        std::cerr << "[Warning]: Process " << seg->owner << " has exited" << std::endl;
+        WS::detach( seg );
+
+        return EXIT_FAILURE;
+    }
+
+    auto last = std::chrono::steady_clock::now();
+
+    while ( true ) {
+        std::this_thread::sleep_for( std::chrono::duration<double>( interval ) );
+
+        /** The owner died while updating the segment */
+        if ( !WS::snapshot( seg, *curr ) ) {
+            std::cerr << "[Warning]: Process " << seg->owner << " has exited" << std::endl;
+            break;
+        }
+
+        auto   now     = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>( now - last ).count();
+
+        if ( !batch ) {
+            printf( "\033[H\033[2J" );
+        }
+
+        printStats( *prev, *curr, elapsed, lines );
+        fflush( stdout );
+
+        /** The owner went away: the segment is stale now */
+        if ( ( kill( curr->owner, 0 ) != 0 ) && ( errno == ESRCH ) ) {
+            std::cerr << "[Warning]: Process " << curr->owner << " has exited" << std::endl;
+            break;
+        }
+
+        std::swap( prev, curr );
+        last = now;
+    }
+
+    WS::detach( seg );
+
+    return EXIT_SUCCESS;
+}
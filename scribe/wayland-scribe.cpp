@@ -28,6 +28,7 @@
  **/
 
 
+#include <set>
 #include <string>
 #include <vector>
 #include <cstring>
@@ -92,6 +93,47 @@ static inline bool endsWith( const std::string& str, const std::string& suffix )
 }
 
 
+/**
+ * Wire signature code of an argument, as used by libwayland.
+ * Untyped new_id arguments (interface, version, id on the wire) are marked 'N'.
+ */
+static inline char signatureCode( const std::string& type, const std::string& interface ) {
+    if ( type == "int" ) {
+        return 'i';
+    }
+
+    else if ( type == "uint" ) {
+        return 'u';
+    }
+
+    else if ( type == "fixed" ) {
+        return 'f';
+    }
+
+    else if ( type == "string" ) {
+        return 's';
+    }
+
+    else if ( type == "object" ) {
+        return 'o';
+    }
+
+    else if ( type == "new_id" ) {
+        return interface.empty() ? 'N' : 'n';
+    }
+
+    else if ( type == "array" ) {
+        return 'a';
+    }
+
+    else if ( type == "fd" ) {
+        return 'h';
+    }
+
+    return '?';
+}
+
+
 std::string snakeCaseToCamelCase( const std::string& snakeCaseName, bool capitalize ) {
     std::string camelCaseName;
     bool        nextToUpper = capitalize;
@@ -173,6 +215,36 @@ void Wayland::Scribe::setRunMode( const std::string& specFile, bool server, uint
 }
 
 
+void Wayland::Scribe::setDecoderMode( const std::string& specFile, const std::string& output ) {
+    mProtocolFilePath = specFile;
+    mDecoder          = true;
+    mFile             = 1;
+
+    std::string tempOutput = output;
+
+    if ( tempOutput.empty() ) {
+        tempOutput = replace( specFile, ".xml", "-decoder" );
+    }
+
+    mOutputSrcPath = ( hasSuffix( tempOutput, 'c' ) ? tempOutput : tempOutput + ".cpp" );
+}
+
+
+void Wayland::Scribe::setDirectMode( const std::string& specFile, const std::string& output ) {
+    mProtocolFilePath = specFile;
+    mDirectShim       = true;
+    mFile             = 2;
+
+    std::string tempOutput = output;
+
+    if ( tempOutput.empty() ) {
+        tempOutput = replace( specFile, ".xml", "-direct" );
+    }
+
+    mOutputHdrPath = ( hasSuffix( tempOutput, 'h' ) ? tempOutput : tempOutput + ".hpp" );
+}
+
+
 void Wayland::Scribe::setArgs( const std::string& headerPath, const std::string& prefix, const std::vector<std::string>& includes ) {
     mHeaderPath = headerPath;
     mPrefix     = prefix;
@@ -183,12 +255,28 @@ void Wayland::Scribe::setArgs( const std::string& headerPath, const std::string&
 }
 
 
+void Wayland::Scribe::setStatistics( bool enabled ) {
+    mStats = enabled;
+}
+
+
+void Wayland::Scribe::setAccounting( bool enabled ) {
+    mAccounting = enabled;
+}
+
+
+void Wayland::Scribe::setDirect( bool enabled ) {
+    mDirect = enabled;
+}
+
+
 Wayland::Scribe::WaylandEvent Wayland::Scribe::readEvent( pugi::xml_node& xml, bool request ) {
     WaylandEvent event = {
         .request   = request,
         .name      = xml.attribute( "name" ).value(),
         .type      = xml.attribute( "type" ).value(),
         .arguments = {},
+        .signature = {},
     };
 
     for (pugi::xml_node argNode : xml.children( "arg" ) ) {
@@ -199,6 +287,7 @@ Wayland::Scribe::WaylandEvent Wayland::Scribe::readEvent( pugi::xml_node& xml, b
             .summary   = argNode.attribute( "summary" ).value(),
             .allowNull = strcmp( argNode.attribute( "allowNull" ).value(),"true" ) == 0,
         };
+        event.signature += signatureCode( argument.type, argument.interface );
         event.arguments.push_back( std::move( argument ) );
     }
 
@@ -251,6 +340,11 @@ Wayland::Scribe::WaylandInterface Wayland::Scribe::readInterface( pugi::xml_node
 
 
 std::string Wayland::Scribe::waylandToCType( const std::string& waylandType, const std::string& interface ) {
+    return waylandToCType( waylandType, interface, mServer );
+}
+
+
+std::string Wayland::Scribe::waylandToCType( const std::string& waylandType, const std::string& interface, bool server ) {
     if ( waylandType == "string" ) {
         return "const char *";
     }
@@ -280,7 +374,7 @@ std::string Wayland::Scribe::waylandToCType( const std::string& waylandType, con
     }
 
     else if ( ( waylandType == "object" ) || ( waylandType == "new_id" ) ) {
-        if ( mServer ) {
+        if ( server ) {
             return "struct ::wl_resource *";
         }
 
@@ -306,10 +400,15 @@ const Wayland::Scribe::WaylandArgument *Wayland::Scribe::newIdArgument( const st
 
 
 void Wayland::Scribe::printEvent( FILE *f, const WaylandEvent& e, bool omitNames, bool withResource, bool capitalize ) {
+    printEvent( f, e, mServer, omitNames, withResource, capitalize );
+}
+
+
+void Wayland::Scribe::printEvent( FILE *f, const WaylandEvent& e, bool server, bool omitNames, bool withResource, bool capitalize ) {
     fprintf( f, "%s( ", snakeCaseToCamelCase( e.name, capitalize ).c_str() );
     bool needsComma = false;
 
-    if ( mServer ) {
+    if ( server ) {
         if ( e.request ) {
             fprintf( f, "Resource *%s", omitNames ? "" : "resource" );
             needsComma = true;
@@ -324,7 +423,7 @@ void Wayland::Scribe::printEvent( FILE *f, const WaylandEvent& e, bool omitNames
     for (const WaylandArgument& a : e.arguments) {
         bool isNewId = a.type == "new_id";
 
-        if ( isNewId && !mServer && ( a.interface.empty() != e.request ) ) {
+        if ( isNewId && !server && ( a.interface.empty() != e.request ) ) {
             continue;
         }
 
@@ -335,7 +434,7 @@ void Wayland::Scribe::printEvent( FILE *f, const WaylandEvent& e, bool omitNames
         needsComma = true;
 
         if ( isNewId ) {
-            if ( mServer ) {
+            if ( server ) {
                 if ( e.request ) {
                     fprintf( f, "uint32_t" );
 
@@ -354,7 +453,7 @@ void Wayland::Scribe::printEvent( FILE *f, const WaylandEvent& e, bool omitNames
             }
         }
 
-        std::string cType = waylandToCType( a.type, a.interface );
+        std::string cType = waylandToCType( a.type, a.interface, server );
         fprintf( f, "%s%s%s", cType.c_str(), endsWith( cType, "&" ) || endsWith( cType, "*" ) ? "" : " ", omitNames ? "" : a.name.c_str() );
     }
     fprintf( f, " )" );
@@ -411,6 +510,209 @@ void Wayland::Scribe::printEnums( FILE *f, const std::vector<WaylandEnum>& enums
 }
 
 
+bool Wayland::Scribe::hasGlue( const WaylandEvent& e ) {
+    // Untyped new_id arguments (wl_registry::bind) expand to three wire arguments
+    return e.signature.find( 'N' ) == std::string::npos;
+}
+
+
+std::string Wayland::Scribe::glueSignature( const WaylandEvent& e ) {
+    std::string key;
+
+    // Collapse the codes that share a C type; new_id is not an argument of client glue
+    for (char code : e.signature) {
+        switch ( code ) {
+            case 'f':
+            case 'h': {
+                key += 'i';
+                break;
+            }
+
+            case 'n': {
+                key += ( mServer ? 'o' : 'n' );
+                break;
+            }
+
+            default: {
+                key += code;
+                break;
+            }
+        }
+    }
+
+    return key;
+}
+
+
+std::string Wayland::Scribe::glueName( const std::string& key ) {
+    return std::string( mServer ? "postEvent" : "marshal" ) + ( key.empty() ? "" : "_" + key );
+}
+
+
+std::string Wayland::Scribe::opcodeName( const WaylandInterface& interface, const WaylandEvent& e ) {
+    std::string name = interface.name + "_" + e.name;
+
+    std::transform( name.begin(), name.end(), name.begin(), ::toupper );
+    return name;
+}
+
+
+void Wayland::Scribe::printGlue( FILE *f, const std::vector<WaylandInterface>& interfaces ) {
+    std::set<std::string> keys;
+
+    for (const WaylandInterface& interface : interfaces) {
+        if ( ignoreInterface( interface.name ) ) {
+            continue;
+        }
+
+        for (const WaylandEvent& e : ( mServer ? interface.events : interface.requests ) ) {
+            if ( hasGlue( e ) ) {
+                keys.insert( glueSignature( e ) );
+            }
+        }
+    }
+
+    if ( keys.empty() ) {
+        return;
+    }
+
+    // One out-of-line copy per signature: identical definitions from other protocols are merged by the linker
+    fprintf( f, "\n" );
+    fprintf( f, "namespace Wayland {\n" );
+    fprintf( f, "namespace Glue {\n" );
+
+    for (const std::string& key : keys) {
+        std::string params;
+        std::string args;
+
+        for (size_t i = 0; i < key.size(); i++) {
+            std::string arg = "arg" + std::to_string( i );
+
+            switch ( key.at( i ) ) {
+                case 'i': {
+                    params += ", int32_t " + arg;
+                    break;
+                }
+
+                case 'u': {
+                    params += ", uint32_t " + arg;
+                    break;
+                }
+
+                case 's': {
+                    params += ", const char *" + arg;
+                    break;
+                }
+
+                case 'o': {
+                    params += ( mServer ? ", struct ::wl_resource *" : ", void *" ) + arg;
+                    break;
+                }
+
+                case 'a': {
+                    params += ", struct ::wl_array *" + arg;
+                    break;
+                }
+
+                case 'n': {
+                    args += ", nullptr";
+                    continue;
+                }
+            }
+
+            args += ", " + arg;
+        }
+
+        std::string name = glueName( key );
+
+        if ( mServer ) {
+            fprintf( f, "[[gnu::noinline]] inline void %s(struct ::wl_resource *resource, uint32_t opcode%s) {\n", name.c_str(), params.c_str() );
+            fprintf( f, "    wl_resource_post_event(resource, opcode%s);\n",                                      args.c_str() );
+            fprintf( f, "}\n" );
+        }
+
+        else {
+            fprintf( f, "[[gnu::noinline]] inline struct ::wl_proxy *%s(struct ::wl_proxy *proxy, uint32_t opcode, const struct ::wl_interface *interface, uint32_t flags%s) {\n", name.c_str(), params.c_str() );
+            fprintf( f, "    return wl_proxy_marshal_flags(proxy, opcode, interface, wl_proxy_get_version(proxy), flags%s);\n",                                                     args.c_str() );
+            fprintf( f, "}\n" );
+        }
+    }
+
+    fprintf( f, "}\n" );
+    fprintf( f, "}\n" );
+}
+
+
+std::string Wayland::Scribe::statsSlotName( const WaylandInterface& interface ) {
+    return snakeCaseToCamelCase( interface.name, false ) + "StatsSlot";
+}
+
+
+void Wayland::Scribe::printStatsSlot( FILE *f, const WaylandInterface& interface ) {
+    // The slot is resolved once, the first time a message of this interface is seen.
+    fprintf( f, "static uint32_t %s() {\n", statsSlotName( interface ).c_str() );
+
+    // Message names, indexed by opcode, so that viewers do not need the protocol
+    std::string names[ 2 ];
+
+    for (const WaylandEvent& e : interface.requests) {
+        names[ 0 ] += std::string( names[ 0 ].empty() ? " " : ", " ) + "\"" + e.name + "\"";
+    }
+
+    for (const WaylandEvent& e : interface.events) {
+        names[ 1 ] += std::string( names[ 1 ].empty() ? " " : ", " ) + "\"" + e.name + "\"";
+    }
+
+    if ( !interface.requests.empty() ) {
+        fprintf( f, "    static const char *const requests[] = {%s };\n", names[ 0 ].c_str() );
+    }
+
+    if ( !interface.events.empty() ) {
+        fprintf( f, "    static const char *const events[] = {%s };\n", names[ 1 ].c_str() );
+    }
+
+    fprintf(
+        f, "    static const uint32_t slot = Wayland::Stats::interfaceSlot(\"%s\", %s, %zu, %s, %zu);\n", interface.name.c_str(),
+        interface.requests.empty() ? "nullptr" : "requests", interface.requests.size(), interface.events.empty() ? "nullptr" : "events", interface.events.size()
+    );
+    fprintf( f, "    return slot;\n" );
+    fprintf( f, "}\n" );
+    fprintf( f, "\n" );
+}
+
+
+std::string Wayland::Scribe::requestReturnType( const WaylandEvent& e ) {
+    const WaylandArgument *new_id = newIdArgument( e.arguments );
+
+    if ( !new_id ) {
+        return "void ";
+    }
+
+    if ( new_id->interface.empty() ) {
+        return "void *";
+    }
+
+    return "struct ::" + new_id->interface + " *";
+}
+
+
+void Wayland::Scribe::printDirectDeclarations( FILE *f, const std::vector<WaylandInterface>& interfaces ) {
+    // The classes of the shim generated with --emit-direct are friends of the wrappers
+    fprintf( f, "namespace Wayland {\n" );
+    fprintf( f, "namespace Direct {\n" );
+
+    for (const WaylandInterface& interface : interfaces) {
+        if ( !ignoreInterface( interface.name ) ) {
+            fprintf( f, "    class %s;\n", snakeCaseToCamelCase( interface.name, true ).c_str() );
+        }
+    }
+
+    fprintf( f, "}\n" );
+    fprintf( f, "}\n" );
+    fprintf( f, "\n" );
+}
+
+
 std::string Wayland::Scribe::stripInterfaceName( const std::string& name, bool capitalize ) {
     if ( !mPrefix.empty() && startsWith( name, mPrefix ) ) {
         return snakeCaseToCamelCase( name.substr( mPrefix.size() ), capitalize );
@@ -489,12 +791,29 @@ bool Wayland::Scribe::process() {
         codePath   = fs::absolute( replace( mOutputSrcPath, "%1", mServer ? "-server" : "-client" ) ).string();
     }
 
+    /** Only one of them is set when generating just the source or the header */
     else {
-        headerPath = fs::absolute( mOutputHdrPath ).string();
-        codePath   = fs::absolute( mOutputSrcPath ).string();
+        headerPath = ( mOutputHdrPath.empty() ? "" : fs::absolute( mOutputHdrPath ).string() );
+        codePath   = ( mOutputSrcPath.empty() ? "" : fs::absolute( mOutputSrcPath ).string() );
     }
 
-    if ( mServer ) {
+    if ( mDecoder ) {
+        FILE *code = fopen( codePath.c_str(), "w" );
+
+        writeHeader( code, mScannerName, mProtocolFilePath, {}, false );
+        generateDecoder( code, interfaces );
+        fclose( code );
+    }
+
+    else if ( mDirectShim ) {
+        FILE *head = fopen( headerPath.c_str(), "w" );
+
+        writeHeader( head, mScannerName, mProtocolFilePath, {}, true );
+        generateDirectShim( head, interfaces );
+        fclose( head );
+    }
+
+    else if ( mServer ) {
         if ( ( mFile == 0 ) || ( mFile == 2 ) ) {
             FILE *head = fopen( headerPath.c_str(), "w" );
 
@@ -550,9 +869,17 @@ void Wayland::Scribe::generateServerHeader( FILE *head, std::vector<WaylandInter
     fprintf( head, "#include <string>\n" );
     fprintf( head, "#include <utility>\n" );
 
+    if ( mAccounting ) {
+        fprintf( head, "#include <unordered_map>\n" );
+    }
+
     fprintf( head, "\n" );
     std::string serverExport;
 
+    if ( mDirect ) {
+        printDirectDeclarations( head, interfaces );
+    }
+
     fprintf( head, "\n" );
     fprintf( head, "namespace Wayland {\n" );
     fprintf( head, "namespace Server {\n" );
@@ -583,6 +910,23 @@ void Wayland::Scribe::generateServerHeader( FILE *head, std::vector<WaylandInter
         fprintf( head, "\n" );
         fprintf( head, "        virtual ~%s();\n",                                            interfaceName );
         fprintf( head, "\n" );
+
+        if ( mDirect ) {
+            fprintf( head, "        // Receives the events of a resource bound for a Wayland::Direct object, instead of its client.\n" );
+            fprintf( head, "        struct DirectPeer {\n" );
+            fprintf( head, "            virtual ~DirectPeer() {}\n" );
+            fprintf( head, "            virtual void directBind(struct ::wl_resource *handle) = 0;\n" );
+
+            for (const WaylandEvent& e : interface.events) {
+                fprintf( head, "            virtual void send" );
+                printEvent( head, e, false, false, true );
+                fprintf( head, " = 0;\n" );
+            }
+
+            fprintf( head, "        };\n" );
+            fprintf( head, "\n" );
+        }
+
         fprintf( head, "        class Resource {\n" );
         fprintf( head, "        public:\n" );
         fprintf( head, "            Resource() : %sObject(nullptr), handle(nullptr) {}\n", interfaceNameStripped );
@@ -591,11 +935,21 @@ void Wayland::Scribe::generateServerHeader( FILE *head, std::vector<WaylandInter
         fprintf( head, "            %s *%sObject;\n",                                      interfaceName, interfaceNameStripped );
         fprintf( head, "            %s *object() { return %sObject; } \n",                 interfaceName, interfaceNameStripped );
         fprintf( head, "            struct ::wl_resource *handle;\n" );
+
+        if ( mDirect ) {
+            fprintf( head, "            DirectPeer *directPeer = nullptr;\n" );
+        }
         fprintf( head, "\n" );
         fprintf( head, "            struct ::wl_client *client() const { return wl_resource_get_client(handle); }\n" );
         fprintf( head, "            int version() const { return wl_resource_get_version(handle); }\n" );
         fprintf( head, "\n" );
         fprintf( head, "            static Resource *fromResource(struct ::wl_resource *resource);\n" );
+
+        if ( mAccounting ) {
+            fprintf( head, "\n" );
+            fprintf( head, "            // Bytes charged to the client for this resource; override when allocate() returns a subclass.\n" );
+            fprintf( head, "            virtual size_t allocationSize() const { return sizeof(Resource); }\n" );
+        }
         fprintf( head, "        };\n" );
         fprintf( head, "\n" );
         fprintf( head, "        void init(struct ::wl_client *client, uint32_t id, int version);\n" );
@@ -620,6 +974,26 @@ void Wayland::Scribe::generateServerHeader( FILE *head, std::vector<WaylandInter
         fprintf( head, "        static int interfaceVersion() { return interface()->version; }\n" );
         fprintf( head, "\n" );
 
+        if ( mDirect ) {
+            fprintf( head, "        // The resource bound next for client and id sends its events to peer; a null peer cancels.\n" );
+            fprintf( head, "        static void expectDirect(struct ::wl_client *client, uint32_t id, DirectPeer *peer);\n" );
+            fprintf( head, "\n" );
+        }
+
+        if ( mAccounting ) {
+            fprintf( head, "        struct ClientUsage {\n" );
+            fprintf( head, "            uint32_t objects = 0;\n" );
+            fprintf( head, "            size_t bytes = 0;\n" );
+            fprintf( head, "        };\n" );
+            fprintf( head, "\n" );
+            fprintf( head, "        // Live resources of this interface owned by client, across all instances.\n" );
+            fprintf( head, "        static ClientUsage clientUsage(struct ::wl_client *client);\n" );
+            fprintf( head, "\n" );
+            fprintf( head, "        // A client binding more than limit resources of this interface gets a protocol error; 0 disables the limit.\n" );
+            fprintf( head, "        static void setClientObjectLimit(uint32_t limit) { m_clientObjectLimit = limit; }\n" );
+            fprintf( head, "        static uint32_t clientObjectLimit() { return m_clientObjectLimit; }\n" );
+        }
+
         printEnums( head, interface.enums );
 
         bool hasEvents = !interface.events.empty();
@@ -684,6 +1058,18 @@ void Wayland::Scribe::generateServerHeader( FILE *head, std::vector<WaylandInter
         fprintf( head, "            %s *parent;\n", interfaceName );
         fprintf( head, "        };\n" );
         fprintf( head, "        DisplayDestroyedListener m_displayDestroyedListener;\n" );
+
+        if ( mAccounting ) {
+            fprintf( head, "\n" );
+            fprintf( head, "        static std::unordered_map<struct ::wl_client*, ClientUsage> m_clientUsage;\n" );
+            fprintf( head, "        static uint32_t m_clientObjectLimit;\n" );
+        }
+
+        if ( mDirect ) {
+            fprintf( head, "\n" );
+            fprintf( head, "        static std::map<std::pair<struct ::wl_client*, uint32_t>, DirectPeer*> m_expectedDirectPeers;\n" );
+            fprintf( head, "        friend class Wayland::Direct::%s;\n", interfaceName );
+        }
         fprintf( head, "    };\n" );
     }
 
@@ -703,6 +1089,19 @@ void Wayland::Scribe::generateServerCode( FILE *code, std::vector<WaylandInterfa
         fprintf( code, "#include <%s/%s-server.hpp>\n", mHeaderPath.c_str(), replace( mProtocolName, "_", "-" ).c_str() );
     }
 
+    printGlue( code, interfaces );
+
+    if ( mStats ) {
+        fprintf( code, "\n" );
+        fprintf( code, "#include <wayland-scribe-stats.hpp>\n" );
+        fprintf( code, "\n" );
+        fprintf( code, "static inline int32_t clientPid(struct ::wl_resource *resource) {\n" );
+        fprintf( code, "    pid_t pid = 0;\n" );
+        fprintf( code, "    wl_client_get_credentials(wl_resource_get_client(resource), &pid, nullptr, nullptr);\n" );
+        fprintf( code, "    return pid;\n" );
+        fprintf( code, "}\n" );
+    }
+
     fprintf( code, "\n" );
 
     bool needsNewLine = false;
@@ -722,6 +1121,10 @@ void Wayland::Scribe::generateServerCode( FILE *code, std::vector<WaylandInterfa
         std::string interfaceNameStrippedBA = stripInterfaceName( interface.name, false );
         const char  *interfaceNameStripped  = interfaceNameStrippedBA.data();
 
+        if ( mStats ) {
+            printStatsSlot( code, interface );
+        }
+
         fprintf( code, "Wayland::Server::%s::%s(struct ::wl_client *client, uint32_t id, int version) {\n", interfaceName, interfaceName );
         fprintf( code, "    m_resource_map.clear();\n" );
         fprintf( code, "    init(client, id, version);\n" );
@@ -800,6 +1203,31 @@ void Wayland::Scribe::generateServerCode( FILE *code, std::vector<WaylandInterfa
         fprintf( code, "}\n" );
         fprintf( code, "\n" );
 
+        if ( mAccounting ) {
+            fprintf( code, "std::unordered_map<struct ::wl_client*, Wayland::Server::%s::ClientUsage> Wayland::Server::%s::m_clientUsage;\n", interfaceName, interfaceName );
+            fprintf( code, "uint32_t Wayland::Server::%s::m_clientObjectLimit = 0;\n", interfaceName );
+            fprintf( code, "\n" );
+
+            fprintf( code, "Wayland::Server::%s::ClientUsage Wayland::Server::%s::clientUsage(struct ::wl_client *client) {\n", interfaceName, interfaceName );
+            fprintf( code, "    auto usage = m_clientUsage.find(client);\n" );
+            fprintf( code, "    return usage != m_clientUsage.end() ? usage->second : ClientUsage();\n" );
+            fprintf( code, "}\n" );
+            fprintf( code, "\n" );
+        }
+
+        if ( mDirect ) {
+            fprintf( code, "std::map<std::pair<struct ::wl_client*, uint32_t>, Wayland::Server::%s::DirectPeer*> Wayland::Server::%s::m_expectedDirectPeers;\n", interfaceName, interfaceName );
+            fprintf( code, "\n" );
+
+            fprintf( code, "void Wayland::Server::%s::expectDirect(struct ::wl_client *client, uint32_t id, DirectPeer *peer) {\n", interfaceName );
+            fprintf( code, "    if (peer)\n" );
+            fprintf( code, "        m_expectedDirectPeers[{client, id}] = peer;\n" );
+            fprintf( code, "    else\n" );
+            fprintf( code, "        m_expectedDirectPeers.erase({client, id});\n" );
+            fprintf( code, "}\n" );
+            fprintf( code, "\n" );
+        }
+
         fprintf( code, "Wayland::Server::%s::Resource *Wayland::Server::%s::allocate() {\n", interfaceName, interfaceName );
         fprintf( code, "    return new Resource;\n" );
         fprintf( code, "}\n" );
@@ -827,6 +1255,18 @@ void Wayland::Scribe::generateServerCode( FILE *code, std::vector<WaylandInterfa
 
         fprintf( code, "void Wayland::Server::%s::destroy_func(struct ::wl_resource *client_resource) {\n", interfaceName );
         fprintf( code, "    Resource *resource = Resource::fromResource(client_resource);\n" );
+
+        if ( mAccounting ) {
+            fprintf( code, "\n" );
+            fprintf( code, "    auto usage = m_clientUsage.find(wl_resource_get_client(client_resource));\n" );
+            fprintf( code, "    if (usage != m_clientUsage.end()) {\n" );
+            fprintf( code, "        usage->second.objects--;\n" );
+            fprintf( code, "        usage->second.bytes -= resource->allocationSize();\n" );
+            fprintf( code, "        if (usage->second.objects == 0)\n" );
+            fprintf( code, "            m_clientUsage.erase(usage);\n" );
+            fprintf( code, "    }\n" );
+            fprintf( code, "\n" );
+        }
         fprintf( code, "    %s *that = resource->%sObject;\n",                                              interfaceName, interfaceNameStripped );
         fprintf( code, "    if (that) {\n" );
         fprintf( code, "        auto it = that->m_resource_map.begin();\n" );
@@ -869,6 +1309,31 @@ void Wayland::Scribe::generateServerCode( FILE *code, std::vector<WaylandInterfa
         fprintf( code, "    wl_resource_set_implementation(handle, %s, resource, destroy_func);",                    interfaceMember.c_str() );
         fprintf( code, "\n" );
         fprintf( code, "    resource->handle = handle;\n" );
+
+        if ( mDirect ) {
+            fprintf( code, "\n" );
+            fprintf( code, "    if (!m_expectedDirectPeers.empty()) {\n" );
+            fprintf( code, "        auto peer = m_expectedDirectPeers.find({wl_resource_get_client(handle), wl_resource_get_id(handle)});\n" );
+            fprintf( code, "        if (peer != m_expectedDirectPeers.end()) {\n" );
+            fprintf( code, "            resource->directPeer = peer->second;\n" );
+            fprintf( code, "            resource->directPeer->directBind(handle);\n" );
+            fprintf( code, "            m_expectedDirectPeers.erase(peer);\n" );
+            fprintf( code, "        }\n" );
+            fprintf( code, "    }\n" );
+        }
+
+        if ( mAccounting ) {
+            fprintf( code, "\n" );
+            fprintf( code, "    struct ::wl_client *client = wl_resource_get_client(handle);\n" );
+            fprintf( code, "    ClientUsage &usage = m_clientUsage[client];\n" );
+            fprintf( code, "    usage.objects++;\n" );
+            fprintf( code, "    usage.bytes += resource->allocationSize();\n" );
+            fprintf( code, "    if (m_clientObjectLimit && usage.objects > m_clientObjectLimit) {\n" );
+            fprintf( code, "        wl_client_post_implementation_error(client, \"%s: client exceeded the limit of %%u objects\", m_clientObjectLimit);\n", interface.name.c_str() );
+            fprintf( code, "    }\n" );
+            fprintf( code, "\n" );
+        }
+
         fprintf( code, "    bindResource(resource);\n" );
         fprintf( code, "    return resource;\n" );
         fprintf( code, "}\n" );
@@ -907,12 +1372,19 @@ void Wayland::Scribe::generateServerCode( FILE *code, std::vector<WaylandInterfa
             }
             fprintf( code, "\n" );
 
-            for (const WaylandEvent& e : interface.requests) {
+            for (size_t opcode = 0; opcode < interface.requests.size(); opcode++) {
+                const WaylandEvent& e = interface.requests.at( opcode );
+
                 fprintf( code, "\n" );
                 fprintf( code, "void Wayland::Server::%s::", interfaceName );
 
                 printEventHandlerSignature( code, e, interfaceName );
                 fprintf( code, " {\n" );
+
+                if ( mStats ) {
+                    fprintf( code, "    Wayland::Stats::count(%s(), %zu, Wayland::Stats::Request, clientPid(resource));\n", statsSlotName( interface ).c_str(), opcode );
+                }
+
                 fprintf( code, "    Resource *r = Resource::fromResource(resource);\n" );
                 fprintf( code, "    if (!r->%sObject) {\n", interfaceNameStripped );
 
@@ -945,7 +1417,9 @@ void Wayland::Scribe::generateServerCode( FILE *code, std::vector<WaylandInterfa
             }
         }
 
-        for (const WaylandEvent& e : interface.events) {
+        for (size_t opcode = 0; opcode < interface.events.size(); opcode++) {
+            const WaylandEvent& e = interface.events.at( opcode );
+
             std::string eventNameBA = snakeCaseToCamelCase( e.name, true );
             const char  *eventName  = eventNameBA.c_str();
             // std::string eventRequestBA = snakeCaseToCamelCase(e.request, false);
@@ -971,43 +1445,43 @@ void Wayland::Scribe::generateServerCode( FILE *code, std::vector<WaylandInterfa
             printEvent( code, e, false, true, true );
             fprintf( code, " {\n" );
 
-            for (const WaylandArgument& a : e.arguments) {
-                if ( a.type != "array" ) {
-                    continue;
-                }
-
-                std::string array         = a.name + "_data";
-                const char  *arrayName    = array.c_str();
-                const char  *variableName = a.name.c_str();
-                fprintf( code, "    struct wl_array %s;\n",                                            arrayName );
-                fprintf( code, "    %s.size = %s.size();\n",                                           arrayName, variableName );
-                fprintf( code, "    %s.data = static_cast<void *>(const_cast<char *>(%s.c_str()));\n", arrayName, variableName );
-                fprintf( code, "    %s.alloc = 0;\n",                                                  arrayName );
+            if ( mStats ) {
+                fprintf( code, "    Wayland::Stats::count(%s(), %zu, Wayland::Stats::Event, clientPid(resource));\n", statsSlotName( interface ).c_str(), opcode );
                 fprintf( code, "\n" );
             }
 
-            fprintf( code, "    %s_send_%s( ", interface.name.c_str(), e.name.c_str() );
-            fprintf( code, "resource" );
-
-            for (const WaylandArgument& a : e.arguments) {
-                fprintf( code, ", " );
+            if ( mDirect ) {
+                fprintf( code, "    Resource *r = Resource::fromResource(resource);\n" );
+                fprintf( code, "    if (r && r->directPeer) {\n" );
+                fprintf( code, "        r->directPeer->send%s(", eventName );
 
-                if ( a.type == "string" ) {
-                    fprintf( code, "%s.c_str()", a.name.c_str() );
+                for (size_t i = 0; i < e.arguments.size(); i++) {
+                    fprintf( code, "%s %s", i ? "," : "", e.arguments.at( i ).name.c_str() );
                 }
 
-                else if ( a.type == "array" ) {
-                    fprintf( code, "&%s_data", a.name.c_str() );
-                }
+                fprintf( code, "%s);\n", e.arguments.empty() ? "" : " " );
+                fprintf( code, "        return;\n" );
+                fprintf( code, "    }\n" );
+                fprintf( code, "\n" );
+            }
 
-                else {
-                    fprintf( code, "%s", a.name.c_str() );
-                }
+            // Events with the same signature share a single Wayland::Glue implementation
+            if ( hasGlue( e ) ) {
+                fprintf( code, "    Wayland::Glue::%s( resource, %s", glueName( glueSignature( e ) ).c_str(), opcodeName( interface, e ).c_str() );
+            }
+
+            else {
+                fprintf( code, "    %s_send_%s( resource", interface.name.c_str(), e.name.c_str() );
+            }
+
+            for (const WaylandArgument& a : e.arguments) {
+                fprintf( code, ", %s", a.name.c_str() );
             }
+
+            fprintf( code, " );\n" );
+            fprintf( code, "}\n" );
         }
 
-        fprintf( code, " );\n" );
-        fprintf( code, "}\n" );
         fprintf( code, "\n" );
     }
 }
@@ -1027,6 +1501,12 @@ void Wayland::Scribe::generateClientHeader( FILE *head, std::vector<WaylandInter
 
     std::string clientExport;
 
+    if ( mDirect ) {
+        fprintf( head, "#include <map>\n" );
+        fprintf( head, "\n" );
+        printDirectDeclarations( head, interfaces );
+    }
+
     fprintf( head, "\n" );
     fprintf( head, "namespace Wayland {\n" );
     fprintf( head, "namespace Client {\n" );
@@ -1068,6 +1548,28 @@ void Wayland::Scribe::generateClientHeader( FILE *head, std::vector<WaylandInter
         fprintf( head, "\n" );
         fprintf( head, "        static const struct ::wl_interface *interface();\n" );
 
+        if ( mDirect ) {
+            fprintf( head, "\n" );
+            fprintf( head, "        // Receives the requests of an object created by a Wayland::Direct object, instead of a wl_proxy.\n" );
+            fprintf( head, "        struct DirectPeer {\n" );
+            fprintf( head, "            virtual ~DirectPeer() {}\n" );
+            fprintf( head, "            virtual void directAttach(%s *object) = 0;\n", interfaceName );
+            fprintf( head, "            virtual %s *directObject() const = 0;\n",    interfaceName );
+            fprintf( head, "            virtual uint32_t directVersion() const = 0;\n" );
+
+            for (const WaylandEvent& e : interface.requests) {
+                fprintf( head, "            virtual %s", requestReturnType( e ).c_str() );
+                printEvent( head, e );
+                fprintf( head, " = 0;\n" );
+            }
+
+            fprintf( head, "        };\n" );
+            fprintf( head, "\n" );
+            fprintf( head, "        // init() and the constructor route the requests of object to peer, until it is unregistered.\n" );
+            fprintf( head, "        static void registerDirect(struct ::%s *object, DirectPeer *peer);\n", interface.name.c_str() );
+            fprintf( head, "        static void unregisterDirect(struct ::%s *object);\n",                 interface.name.c_str() );
+        }
+
         printEnums( head, interface.enums );
 
         if ( !interface.requests.empty() ) {
@@ -1118,6 +1620,14 @@ void Wayland::Scribe::generateClientHeader( FILE *head, std::vector<WaylandInter
         }
 
         fprintf( head, "        struct ::%s *m_%s;\n", interface.name.c_str(), interface.name.c_str() );
+
+        if ( mDirect ) {
+            fprintf( head, "\n" );
+            fprintf( head, "        bool initDirect();\n" );
+            fprintf( head, "        DirectPeer *m_direct = nullptr;\n" );
+            fprintf( head, "        static std::map<struct ::%s *, DirectPeer *> m_directPeers;\n", interface.name.c_str() );
+            fprintf( head, "        friend class Wayland::Direct::%s;\n",                           interfaceName );
+        }
         fprintf( head, "    };\n" );
     }
     fprintf( head, "}\n" );
@@ -1136,6 +1646,13 @@ void Wayland::Scribe::generateClientCode( FILE *code, std::vector<WaylandInterfa
         fprintf( code, "#include <%s/%s-client.hpp>\n", mHeaderPath.c_str(), replace( mProtocolName, "_", "-" ).c_str() );
     }
 
+    printGlue( code, interfaces );
+
+    if ( mStats ) {
+        fprintf( code, "\n" );
+        fprintf( code, "#include <wayland-scribe-stats.hpp>\n" );
+    }
+
     fprintf( code, "\n" );
 
     // wl_registry_bind is part of the protocol, so we can't use that... instead we use core
@@ -1164,6 +1681,10 @@ void Wayland::Scribe::generateClientCode( FILE *code, std::vector<WaylandInterfa
 
         bool hasEvents = !interface.events.empty();
 
+        if ( mStats ) {
+            printStatsSlot( code, interface );
+        }
+
         fprintf( code, "Wayland::Client::%s::%s(struct ::wl_registry *registry, uint32_t id, int version) {\n", interfaceName, interfaceName );
         fprintf( code, "    init(registry, id, version);\n" );
         fprintf( code, "}\n" );
@@ -1172,7 +1693,12 @@ void Wayland::Scribe::generateClientCode( FILE *code, std::vector<WaylandInterfa
         fprintf( code, "Wayland::Client::%s::%s(struct ::%s *obj)\n", interfaceName, interfaceName, interface.name.c_str() );
         fprintf( code, "    : m_%s(obj) {\n",                         interface.name.c_str() );
 
-        if ( hasEvents ) {
+        if ( mDirect ) {
+            fprintf( code, "    %sinitDirect()%s\n", hasEvents ? "if (!" : "", hasEvents ? ")" : ";" );
+            fprintf( code, "%s",                      hasEvents ? "        init_listener();\n" : "" );
+        }
+
+        else if ( hasEvents ) {
             fprintf( code, "    init_listener();\n" );
         }
 
@@ -1185,6 +1711,12 @@ void Wayland::Scribe::generateClientCode( FILE *code, std::vector<WaylandInterfa
         fprintf( code, "\n" );
 
         fprintf( code, "Wayland::Client::%s::~%s() {\n", interfaceName, interfaceName );
+
+        if ( mDirect ) {
+            fprintf( code, "    if (m_direct)\n" );
+            fprintf( code, "        m_direct->directAttach(nullptr);\n" );
+        }
+
         fprintf( code, "}\n" );
         fprintf( code, "\n" );
 
@@ -1204,7 +1736,12 @@ void Wayland::Scribe::generateClientCode( FILE *code, std::vector<WaylandInterfa
         fprintf( code, "void Wayland::Client::%s::init(struct ::%s *obj) {\n", interfaceName, interface.name.c_str() );
         fprintf( code, "    m_%s = obj;\n",                                    interface.name.c_str() );
 
-        if ( hasEvents ) {
+        if ( mDirect ) {
+            fprintf( code, "    %sinitDirect()%s\n", hasEvents ? "if (!" : "", hasEvents ? ")" : ";" );
+            fprintf( code, "%s",                      hasEvents ? "        init_listener();\n" : "" );
+        }
+
+        else if ( hasEvents ) {
             fprintf( code, "    init_listener();\n" );
         }
 
@@ -1213,6 +1750,14 @@ void Wayland::Scribe::generateClientCode( FILE *code, std::vector<WaylandInterfa
 
         fprintf( code, "Wayland::Client::%s *Wayland::Client::%s::fromObject(struct ::%s *object) {\n", interfaceName, interfaceName, interface.name.c_str() );
 
+        if ( mDirect ) {
+            // Handlers receive the tokens of direct objects, which are not proxies
+            fprintf( code, "    auto peer = m_directPeers.find(object);\n" );
+            fprintf( code, "    if (peer != m_directPeers.end())\n" );
+            fprintf( code, "        return peer->second->directObject();\n" );
+            fprintf( code, "\n" );
+        }
+
         if ( hasEvents ) {
             fprintf( code, "    if (wl_proxy_get_listener((struct ::wl_proxy *)object) != (void *)&m_%s_listener)\n", interface.name.c_str() );
             fprintf( code, "        return nullptr;\n" );
@@ -1228,15 +1773,49 @@ void Wayland::Scribe::generateClientCode( FILE *code, std::vector<WaylandInterfa
         fprintf( code, "\n" );
 
         fprintf( code, "uint32_t Wayland::Client::%s::version() const {\n",                     interfaceName );
+
+        if ( mDirect ) {
+            fprintf( code, "    if (m_direct)\n" );
+            fprintf( code, "        return m_direct->directVersion();\n" );
+        }
+
         fprintf( code, "    return wl_proxy_get_version(reinterpret_cast<wl_proxy*>(m_%s));\n", interface.name.c_str() );
         fprintf( code, "}\n" );
         fprintf( code, "\n" );
 
+        if ( mDirect ) {
+            fprintf( code, "std::map<struct ::%s *, Wayland::Client::%s::DirectPeer *> Wayland::Client::%s::m_directPeers;\n", interface.name.c_str(), interfaceName, interfaceName );
+            fprintf( code, "\n" );
+
+            fprintf( code, "void Wayland::Client::%s::registerDirect(struct ::%s *object, DirectPeer *peer) {\n", interfaceName, interface.name.c_str() );
+            fprintf( code, "    m_directPeers[object] = peer;\n" );
+            fprintf( code, "}\n" );
+            fprintf( code, "\n" );
+
+            fprintf( code, "void Wayland::Client::%s::unregisterDirect(struct ::%s *object) {\n", interfaceName, interface.name.c_str() );
+            fprintf( code, "    m_directPeers.erase(object);\n" );
+            fprintf( code, "}\n" );
+            fprintf( code, "\n" );
+
+            fprintf( code, "bool Wayland::Client::%s::initDirect() {\n", interfaceName );
+            fprintf( code, "    auto peer = m_directPeers.find(m_%s);\n", interface.name.c_str() );
+            fprintf( code, "    if (peer == m_directPeers.end())\n" );
+            fprintf( code, "        return false;\n" );
+            fprintf( code, "\n" );
+            fprintf( code, "    m_direct = peer->second;\n" );
+            fprintf( code, "    m_direct->directAttach(this);\n" );
+            fprintf( code, "    return true;\n" );
+            fprintf( code, "}\n" );
+            fprintf( code, "\n" );
+        }
+
         fprintf( code, "const struct wl_interface *Wayland::Client::%s::interface() {\n", interfaceName );
         fprintf( code, "    return &::%s_interface;\n",                                   interface.name.c_str() );
         fprintf( code, "}\n" );
 
-        for (const WaylandEvent& e : interface.requests) {
+        for (size_t opcode = 0; opcode < interface.requests.size(); opcode++) {
+            const WaylandEvent& e = interface.requests.at( opcode );
+
             fprintf( code, "\n" );
             const WaylandArgument *new_id    = newIdArgument( e.arguments );
             std::string           new_id_str = "void ";
@@ -1253,6 +1832,73 @@ void Wayland::Scribe::generateClientCode( FILE *code, std::vector<WaylandInterfa
             fprintf( code, "%s Wayland::Client::%s::", new_id_str.c_str(), interfaceName );
             printEvent( code, e );
             fprintf( code, " {\n" );
+
+            if ( mStats ) {
+                fprintf( code, "    Wayland::Stats::count(%s(), %zu, Wayland::Stats::Request, 0);\n", statsSlotName( interface ).c_str(), opcode );
+            }
+
+            if ( mDirect ) {
+                std::string directArgs;
+
+                for (const WaylandArgument& a : e.arguments) {
+                    if ( ( a.type == "new_id" ) && !a.interface.empty() ) {
+                        continue;
+                    }
+
+                    directArgs += ( directArgs.empty() ? " " : ", " );
+                    directArgs += ( a.type == "new_id" ? std::string( "interface, version" ) : a.name );
+                }
+
+                directArgs += ( directArgs.empty() ? "" : " " );
+
+                fprintf( code, "    if (m_direct) {\n" );
+
+                if ( e.type == "destructor" ) {
+                    fprintf( code, "        m_direct->%s(%s);\n", snakeCaseToCamelCase( e.name, false ).c_str(), directArgs.c_str() );
+                    fprintf( code, "        m_direct = nullptr;\n" );
+                    fprintf( code, "        m_%s = nullptr;\n",   interface.name.c_str() );
+                    fprintf( code, "        return;\n" );
+                }
+
+                else {
+                    fprintf( code, "        return m_direct->%s(%s);\n", snakeCaseToCamelCase( e.name, false ).c_str(), directArgs.c_str() );
+                }
+
+                fprintf( code, "    }\n" );
+                fprintf( code, "\n" );
+            }
+
+            // Requests with the same signature share a single Wayland::Glue implementation
+            if ( hasGlue( e ) ) {
+                std::string newIdInterface = ( new_id ? "&::" + new_id->interface + "_interface" : std::string( "nullptr" ) );
+
+                if ( new_id ) {
+                    fprintf( code, "    return reinterpret_cast<struct ::%s *>(", new_id->interface.c_str() );
+                }
+
+                else {
+                    fprintf( code, "    " );
+                }
+
+                fprintf( code, "Wayland::Glue::%s( reinterpret_cast<struct ::wl_proxy *>(m_%s), %s, ", glueName( glueSignature( e ) ).c_str(), interface.name.c_str(), opcodeName( interface, e ).c_str() );
+                fprintf( code, "%s, %s",                                                               newIdInterface.c_str(), e.type == "destructor" ? "WL_MARSHAL_FLAG_DESTROY" : "0" );
+
+                for (const WaylandArgument& a : e.arguments) {
+                    if ( a.type != "new_id" ) {
+                        fprintf( code, ", %s", a.name.c_str() );
+                    }
+                }
+
+                fprintf( code, " )%s;\n", new_id ? ")" : "" );
+
+                if ( e.type == "destructor" ) {
+                    fprintf( code, "    m_%s = nullptr;\n", interface.name.c_str() );
+                }
+
+                fprintf( code, "}\n" );
+                continue;
+            }
+
             for (const WaylandArgument& a : e.arguments) {
                 if ( a.type != "array" ) {
                     continue;
@@ -1313,7 +1959,9 @@ void Wayland::Scribe::generateClientCode( FILE *code, std::vector<WaylandInterfa
 
         if ( hasEvents ) {
             fprintf( code, "\n" );
-            for (const WaylandEvent& e : interface.events) {
+            for (size_t opcode = 0; opcode < interface.events.size(); opcode++) {
+                const WaylandEvent& e = interface.events.at( opcode );
+
                 fprintf( code, "void Wayland::Client::%s::", interfaceName );
                 printEvent( code, e, true );
                 fprintf( code, " {\n" );
@@ -1322,6 +1970,11 @@ void Wayland::Scribe::generateClientCode( FILE *code, std::vector<WaylandInterfa
                 fprintf( code, "void Wayland::Client::%s::", interfaceName );
                 printEventHandlerSignature( code, e, interface.name.c_str() );
                 fprintf( code, " {\n" );
+
+                if ( mStats ) {
+                    fprintf( code, "    Wayland::Stats::count(%s(), %zu, Wayland::Stats::Event, 0);\n", statsSlotName( interface ).c_str(), opcode );
+                }
+
                 fprintf( code, "    static_cast<Wayland::Client::%s *>(data)->%s( ", interfaceName, snakeCaseToCamelCase( e.name.c_str(), false ).c_str() );
                 bool needsComma = false;
                 for (const WaylandArgument& a : e.arguments) {
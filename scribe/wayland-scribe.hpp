@@ -29,6 +29,8 @@
 
 #pragma once
 
+#include <map>
+#include <set>
 #include <vector>
 #include <filesystem>
 
@@ -48,8 +50,23 @@ class Wayland::Scribe {
         bool process();
 
         void setRunMode( const std::string& specFile, bool server, uint file, const std::string& output );
+
+        /** Generate a standalone decoder of captured wire traffic instead of the wrappers */
+        void setDecoderMode( const std::string& specFile, const std::string& output );
+
+        /** Generate the header-only shim connecting the server and client classes in-process instead of the wrappers */
+        void setDirectMode( const std::string& specFile, const std::string& output );
         void setArgs( const std::string& headerPath, const std::string& prefix, const std::vector<std::string>& includes );
 
+        /** Publish message counters into the shared-memory segment of wayland-scribe-stats.hpp */
+        void setStatistics( bool enabled );
+
+        /** Keep per-client counts of live resources in the generated server classes */
+        void setAccounting( bool enabled );
+
+        /** Add the hooks used by the in-process shim of setDirectMode() to the generated classes */
+        void setDirect( bool enabled );
+
     private:
         struct WaylandEnumEntry {
             std::string name;
@@ -75,6 +92,9 @@ class Wayland::Scribe {
             std::string                  name;
             std::string                  type;
             std::vector<WaylandArgument> arguments;
+
+            /** Wire signature of the arguments (libwayland codes; 'N' for an untyped new_id) */
+            std::string                  signature;
         };
 
         struct WaylandInterface {
@@ -92,20 +112,49 @@ class Wayland::Scribe {
         void generateClientHeader( FILE *head, std::vector<WaylandInterface> interfaces );
         void generateClientCode( FILE *head, std::vector<WaylandInterface> interfaces );
 
+        void generateDecoder( FILE *code, std::vector<WaylandInterface> interfaces );
+        std::string decoderLayoutName( const WaylandInterface& interface, const WaylandEvent& e );
+        void printDecoderLayout( FILE *code, const WaylandInterface& interface, const WaylandEvent& e, std::map<std::string, size_t>& indices );
+        void printDecoderMessage( FILE *code, const WaylandInterface& interface, const WaylandEvent& e );
+
+        void generateDirectShim( FILE *head, std::vector<WaylandInterface> interfaces );
+        void printDirectClass( FILE *head, const WaylandInterface& interface );
+        void printDirectRequest( FILE *head, const WaylandInterface& interface, const WaylandEvent& e, const std::set<std::string>& direct );
+        void printDirectEvent( FILE *head, const WaylandInterface& interface, const WaylandEvent& e, const std::set<std::string>& direct );
+
         WaylandEvent readEvent( pugi::xml_node& xml, bool request );
         Scribe::WaylandEnum readEnum( pugi::xml_node& xml );
         Scribe::WaylandInterface readInterface( pugi::xml_node& xml );
         std::string waylandToCType( const std::string& waylandType, const std::string& interface );
+        std::string waylandToCType( const std::string& waylandType, const std::string& interface, bool server );
         const Scribe::WaylandArgument *newIdArgument( const std::vector<WaylandArgument>& arguments );
 
         void printEvent( FILE *f, const WaylandEvent& e, bool omitNames = false, bool withResource = false, bool capitalize = false );
+        void printEvent( FILE *f, const WaylandEvent& e, bool server, bool omitNames, bool withResource, bool capitalize );
         void printEventHandlerSignature( FILE *f, const WaylandEvent& e, const char *interfaceName );
         void printEnums( FILE *f, const std::vector<WaylandEnum>& enums );
 
+        bool hasGlue( const WaylandEvent& e );
+        std::string glueSignature( const WaylandEvent& e );
+        std::string glueName( const std::string& key );
+        std::string opcodeName( const WaylandInterface& interface, const WaylandEvent& e );
+        void printGlue( FILE *f, const std::vector<WaylandInterface>& interfaces );
+
+        std::string requestReturnType( const WaylandEvent& e );
+        void printDirectDeclarations( FILE *f, const std::vector<WaylandInterface>& interfaces );
+
+        std::string statsSlotName( const WaylandInterface& interface );
+        void printStatsSlot( FILE *f, const WaylandInterface& interface );
+
         std::string stripInterfaceName( const std::string& name, bool );
         bool ignoreInterface( const std::string& name );
 
-        bool mServer = false;
+        bool mServer     = false;
+        bool mStats      = false;
+        bool mAccounting = false;
+        bool mDecoder    = false;
+        bool mDirect     = false;
+        bool mDirectShim = false;
 
         /**
          * File(s) to be generated